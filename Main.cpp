@@ -1,4 +1,4 @@
-#include <GLAD/glad.h>
+#include <glad/glad.h>
 #include <GLFW/glfw3.h>
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
@@ -8,56 +8,82 @@
 #include <imgui_impl_glfw.h>
 #include <imgui_impl_opengl3.h>
 
+#include <algorithm>
+#include <cmath>
 #include <vector>
 #include <iostream>
-#include <cstdlib>
+#include <string>
 
-const unsigned int SCR_WIDTH = 1920;
-const unsigned int SCR_HEIGHT = 1080;
+#include "config.h"
+#include "fixed_timestep.h"
+#include "job_system.h"
+#include "particle_system.h"
+#include "scene_file.h"
 
-struct Particle {
-    glm::vec2 position;
-    glm::vec2 velocity;
-    float lifetime;
-    glm::vec4 color;
-};
-
-float particleVelocity = 100.0f;
-float particleLifetime = 5.0f;
 int maxParticles = 2000;
-std::vector<Particle> particles(maxParticles);
+ParticleSystem particleSystem(maxParticles);
+int mouseEmitter = -1;
 bool iman = true;
 
-float obstacleSize = 200.0f;
+float simulationRate = 60.0f;
+int maxCatchUpSteps = 4;
+FixedTimestep timestep(simulationRate, maxCatchUpSteps);
 
-struct Obstacle {
-    glm::vec2 position;
-    float size;
-    int type; // 0 = square, 1 = triangle, 2 = circle
+float obstacleSize = 200.0f;
+int scatterCount = 100;
+// Polygon shape behind the Create Star button, registered on first use.
+int starShape = -1;
+const char* SCENE_PATH = "scene.pscene";
+bool saveSceneParticles = true;
+// Obstacle held with the middle mouse button, and where it was grabbed.
+int draggedObstacle = -1;
+glm::vec2 dragOffset(0.0f);
+bool deletePressed = false;
+
+struct ParticleBatch {
+    unsigned int vao, vbo;
 };
 
-std::vector<Obstacle> obstacles;
-
-unsigned int VAO, VBO, shaderProgram;
+std::vector<ParticleBatch> particleBatches;
+// Filled by the last simulation step of each frame, in pool slot order.
+std::vector<ParticleVertex> particleVertices;
+unsigned int shaderProgram;
 bool leftMousePressed = false, rightMousePressed = false;
 double mouseX = 0.0, mouseY = 0.0;
 glm::mat4 projection;
 
-glm::vec4 particleColor = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
-
 const char* vertexShaderSource = R"(
 #version 330 core
 layout (location = 0) in vec2 aPos;
 layout (location = 1) in vec4 aColor;
+layout (location = 2) in float aLifetime;
 
 out vec4 particleColor;
 
 uniform mat4 view;
 uniform mat4 projection;
+uniform vec4 tint;
+uniform float lifetime;
+uniform int stopCount;
+uniform float stopPositions[8];
+uniform vec4 stopColors[8];
+
+// Same as ColorGradient::evaluate.
+vec4 colorOverLife(float age) {
+    if (age <= stopPositions[0]) return stopColors[0];
+    for (int i = 1; i < stopCount; ++i) {
+        if (age < stopPositions[i]) {
+            float t = (age - stopPositions[i - 1]) / (stopPositions[i] - stopPositions[i - 1]);
+            return mix(stopColors[i - 1], stopColors[i], t);
+        }
+    }
+    return stopColors[stopCount - 1];
+}
 
 void main() {
     gl_Position = projection * vec4(aPos, 0.0, 1.0);
-    particleColor = aColor;
+    float age = clamp(1.0 - aLifetime / lifetime, 0.0, 1.0);
+    particleColor = aColor * tint * colorOverLife(age);
     gl_PointSize = 5.0;
 }
 )";
@@ -76,14 +102,12 @@ void framebuffer_size_callback(GLFWwindow* window, int width, int height);
 void processInput(GLFWwindow* window);
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods);
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos);
-void initializeParticles();
-void updateParticles(float deltaTime);
-void setupParticleRendering();
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset);
+ParticleBatch createParticleBatch();
 void renderParticles();
 void renderObstacles();
+void setColorUniforms(glm::vec4 tint, const ColorGradient& gradient, float lifetime);
 void setupShader();
-bool isPointInTriangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c);
-glm::vec2 getRandomValidPosition(float size);
 glm::vec2 getWorldPositionFromMouse(double mouseX, double mouseY);
 void setupImGui(GLFWwindow* window);
 
@@ -104,6 +128,7 @@ int main() {
     glfwSetFramebufferSizeCallback(window, framebuffer_size_callback);
     glfwSetMouseButtonCallback(window, mouse_button_callback);
     glfwSetCursorPosCallback(window, cursor_position_callback);
+    glfwSetScrollCallback(window, scroll_callback);
 
     if (!gladLoadGLLoader((GLADloadproc)glfwGetProcAddress)) {
         std::cout << "Failed to initialize GLAD" << std::endl;
@@ -112,8 +137,10 @@ int main() {
 
     setupImGui(window);
 
-    initializeParticles();
-    setupParticleRendering();
+    mouseEmitter = particleSystem.addEmitter(Emitter());
+
+    JobSystem jobSystem;
+    particleSystem.setJobSystem(&jobSystem);
 
     unsigned int vertexShader = glCreateShader(GL_VERTEX_SHADER);
     glShaderSource(vertexShader, 1, &vertexShaderSource, nullptr);
@@ -140,12 +167,23 @@ int main() {
         lastFrame = currentFrame;
 
         processInput(window);
-        updateParticles(deltaTime);
+        glm::vec2 cursorPos = getWorldPositionFromMouse(mouseX, mouseY);
+        if (draggedObstacle >= 0) {
+            particleSystem.moveObstacle(draggedObstacle, cursorPos + dragOffset);
+        }
 
-        for (auto& particle : particles) {
-            if (particle.lifetime > 0.0f) {
-                particle.color = particleColor;
-            }
+        Emitter& emitter = particleSystem.getEmitter(mouseEmitter);
+        emitter.position = cursorPos;
+        emitter.enabled = leftMousePressed && !ImGui::GetIO().WantCaptureMouse;
+        emitter.setSpread(particleSystem.getSettings().velocity, particleSystem.getSettings().lifetime);
+
+        int steps = timestep.advance(deltaTime);
+        for (int step = 0; step < steps; ++step) {
+            std::vector<ParticleVertex>* vertices = step == steps - 1 ? &particleVertices : nullptr;
+            particleSystem.update(timestep.getStep(), rightMousePressed, iman, cursorPos, vertices, timestep.getAlpha());
+        }
+        if (steps == 0) {
+            particleSystem.writeVertices(timestep.getAlpha(), particleVertices);
         }
 
         glClear(GL_COLOR_BUFFER_BIT);
@@ -156,31 +194,50 @@ int main() {
 
         ImGui::Begin("Settings");
 
+        ParticleSettings& settings = particleSystem.getSettings();
+
         ImGui::LabelText("---------", "Obstacle Settings");
 
-        if (ImGui::SliderInt("Max Particles", &maxParticles, 1, 2000)) {
-            particles.resize(maxParticles);
+        if (ImGui::SliderInt("Max Particles", &maxParticles, 1, 4000000, "%d", ImGuiSliderFlags_Logarithmic)) {
+            particleSystem.resize(maxParticles);
             std::cout << "Max Particles changed to " << maxParticles << std::endl;
         }
         if (ImGui::Button("Reset Max")) {
             std::cout << "Max Particles reseted to 2000" << std::endl;
-            particles.resize(2000);
+            maxParticles = 2000;
+            particleSystem.resize(maxParticles);
         }
 
-        if (ImGui::SliderFloat("Particles Lifetime", &particleLifetime, 0.1f, 20.0f)) {
-            std::cout << "Lifetime changed to " << particleLifetime << std::endl;
+        if (ImGui::SliderFloat("Particles Lifetime", &settings.lifetime, 0.1f, 20.0f)) {
+            std::cout << "Lifetime changed to " << settings.lifetime << std::endl;
         }
         if (ImGui::Button("Reset Lifetime")) {
             std::cout << "Lifetime reseted" << std::endl;
-            particleLifetime = 5.0f;
+            settings.lifetime = 5.0f;
         }
 
-        if (ImGui::SliderFloat("Particles Velocity", &particleVelocity, 0.1f, 500)) {
-            std::cout << "Velocity changed to " << particleVelocity << std::endl;
+        if (ImGui::SliderFloat("Particles Velocity", &settings.velocity, 0.1f, 500)) {
+            std::cout << "Velocity changed to " << settings.velocity << std::endl;
         }
         if (ImGui::Button("Reset Velocity")) {
             std::cout << "Velocity reseted" << std::endl;
-            particleVelocity = 100.0f;
+            settings.velocity = 100.0f;
+        }
+
+        ImGui::ColorEdit4("Particle Color", &settings.color.r);
+        bool fadeOut = settings.colorOverLife.getStopCount() > 1;
+        if (ImGui::Checkbox("Fade Out", &fadeOut)) {
+            settings.colorOverLife.setConstant(glm::vec4(1.0f));
+            if (fadeOut) settings.colorOverLife.addStop(1.0f, glm::vec4(0.0f, 0.0f, 0.0f, 1.0f));
+        }
+
+        Emitter& emitterSettings = particleSystem.getEmitter(mouseEmitter);
+        if (ImGui::SliderFloat("Emission Rate", &emitterSettings.rate, 1.0f, 100000.0f, "%.0f", ImGuiSliderFlags_Logarithmic)) {
+            std::cout << "Emission rate changed to " << emitterSettings.rate << std::endl;
+        }
+        if (ImGui::Button("Reset Emission Rate")) {
+            std::cout << "Emission rate reseted" << std::endl;
+            emitterSettings.rate = 60.0f;
         }
 
         if (ImGui::Button(iman ? "Repel Particles" : "Attract Particles")) {
@@ -189,33 +246,114 @@ int main() {
             else std::cout << "Repel Particles" << std::endl;
         }
 
+        ImGui::Checkbox("N-body Gravity", &settings.gravity.enabled);
+        if (settings.gravity.enabled) {
+            ImGui::SliderFloat("Gravity Strength", &settings.gravity.strength, -10000.0f, 10000.0f, "%.0f");
+            ImGui::RadioButton("Barnes-Hut", &settings.gravity.solver, GRAVITY_BARNES_HUT);
+            ImGui::SameLine();
+            ImGui::RadioButton("Particle Mesh", &settings.gravity.solver, GRAVITY_PARTICLE_MESH);
+            if (settings.gravity.solver == GRAVITY_BARNES_HUT) {
+                ImGui::SliderFloat("Opening Angle", &settings.gravity.theta, 0.0f, 1.5f, "%.2f");
+            }
+            else {
+                ImGui::SliderInt("Mesh Size", &settings.gravity.meshSize, 32, 1024, "%d", ImGuiSliderFlags_Logarithmic);
+            }
+        }
+
+        ImGui::Checkbox("Particle Collisions", &settings.collisions.enabled);
+        if (settings.collisions.enabled) {
+            ImGui::SliderFloat("Particle Radius", &settings.collisions.radius, 0.5f, 10.0f, "%.1f");
+        }
+
+        ImGui::Checkbox("Fluid (SPH)", &settings.fluid.enabled);
+        if (settings.fluid.enabled) {
+            ImGui::SliderFloat("Fluid Stiffness", &settings.fluid.stiffness, 1.0e4f, 4.0e6f, "%.0f", ImGuiSliderFlags_Logarithmic);
+            ImGui::SliderFloat("Fluid Viscosity", &settings.fluid.viscosity, 0.0f, 50.0f, "%.1f");
+            ImGui::SliderInt("Fluid Substeps", &settings.fluid.substeps, 1, 16);
+            const FluidTimings& timings = particleSystem.getFluidTimings();
+            ImGui::Text("neighbors %.2f ms, density %.2f ms, forces %.2f ms, integrate %.2f ms",
+                timings.neighbors, timings.density, timings.forces, timings.integrate);
+        }
+
+        ImGui::SliderInt("Morton Reorder Interval", &settings.reorder.interval, 0, 120, settings.reorder.interval > 0 ? "every %d updates" : "off");
+
+        if (ImGui::SliderFloat("Simulation Rate", &simulationRate, 10.0f, 240.0f, "%.0f Hz")) {
+            timestep.setRate(simulationRate);
+            std::cout << "Simulation rate changed to " << simulationRate << std::endl;
+        }
+        if (ImGui::SliderInt("Max Catch-up Steps", &maxCatchUpSteps, 1, 16)) {
+            timestep.setMaxSteps(maxCatchUpSteps);
+            std::cout << "Max catch-up steps changed to " << maxCatchUpSteps << std::endl;
+        }
+
         ImGui::LabelText("---------", "Obstacle Settings");
 
-        if (ImGui::Button("Create Square")) {
-            glm::vec2 pos = getRandomValidPosition(obstacleSize);
-            obstacles.push_back({ pos, obstacleSize, 0 });
-            std::cout << "Square created at: " << pos.x << ", " << pos.y << std::endl;
+        static const char* obstacleNames[OBSTACLE_TYPE_COUNT] = { "Square", "Triangle", "Circle", "Star" };
+        for (int type = 0; type < OBSTACLE_TYPE_COUNT; ++type) {
+            std::string label = std::string("Create ") + obstacleNames[type];
+            if (ImGui::Button(label.c_str())) {
+                if (type == OBSTACLE_POLYGON && starShape < 0) {
+                    starShape = particleSystem.addPolygonShape(makeStarVertices(5, 0.4f));
+                }
+                if (particleSystem.placeObstacles(1, obstacleSize, type, starShape) == 1) {
+                    glm::vec2 pos = particleSystem.getObstacles().back().position;
+                    std::cout << obstacleNames[type] << " created at: " << pos.x << ", " << pos.y << std::endl;
+                }
+                else {
+                    std::cout << "No room for a " << obstacleNames[type] << " of size " << obstacleSize << std::endl;
+                }
+            }
         }
-        if (ImGui::Button("Create Triangle")) {
-            glm::vec2 pos = getRandomValidPosition(obstacleSize);
-            obstacles.push_back({ pos, obstacleSize, 1 });
-            std::cout << "Triangle created at: " << pos.x << ", " << pos.y << std::endl;
+
+        if (ImGui::SliderFloat("Obstacle Size", &obstacleSize, 5.0f, 1000.0f, "%.0f", ImGuiSliderFlags_Logarithmic)) {
+            std::cout << "Obstacle size changed to " << obstacleSize << std::endl;
         }
-        if (ImGui::Button("Create Circle")) {
-            glm::vec2 pos = getRandomValidPosition(obstacleSize);
-            obstacles.push_back({ pos, obstacleSize, 2 });
-            std::cout << "Circle created at: " << pos.x << ", " << pos.y << std::endl;
+
+        ImGui::SliderInt("Scatter Count", &scatterCount, 1, 10000, "%d", ImGuiSliderFlags_Logarithmic);
+        if (ImGui::Button("Scatter Obstacles")) {
+            int placed = particleSystem.placeObstacles(scatterCount, obstacleSize);
+            std::cout << "Scattered " << placed << " of " << scatterCount << " obstacles" << std::endl;
         }
 
-        if (ImGui::SliderFloat("Obstacle Size", &obstacleSize, 100.0f, 1000.0f)) {
-            std::cout << "Obstacle size changed to " << particleVelocity << std::endl;
+        ImGui::Checkbox("Distance Field Obstacles", &settings.obstacleField.enabled);
+        if (settings.obstacleField.enabled) {
+            ImGui::SliderFloat("Field Cell Size", &settings.obstacleField.cellSize, 0.5f, 8.0f, "%.1f px");
         }
 
         if (ImGui::Button("Delete All Objects")) {
-            obstacles.clear();
+            particleSystem.clearObstacles();
             std::cout << "All objects deleted" << std::endl;
         }
 
+        ImGui::LabelText("---------", "Scene");
+
+        ImGui::Checkbox("Save Particles", &saveSceneParticles);
+        if (ImGui::Button("Save Scene")) {
+            if (saveScene(SCENE_PATH, particleSystem, saveSceneParticles)) {
+                std::cout << "Scene saved to " << SCENE_PATH << std::endl;
+            }
+            else {
+                std::cout << "Could not write " << SCENE_PATH << std::endl;
+            }
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Load Scene")) {
+            SceneFile scene;
+            if (scene.open(SCENE_PATH)) {
+                scene.apply(particleSystem, &jobSystem);
+                // The mouse emitter was saved as the first emitter.
+                if (particleSystem.getEmitters().empty()) particleSystem.addEmitter(Emitter());
+                mouseEmitter = 0;
+                maxParticles = particleSystem.getPool().getCapacity();
+                starShape = -1;
+                draggedObstacle = -1;
+                std::cout << "Scene loaded from " << SCENE_PATH << std::endl;
+            }
+            else {
+                std::cout << "Could not load " << SCENE_PATH << std::endl;
+            }
+        }
+
         ImGui::End();
 
         renderParticles();
@@ -244,6 +382,17 @@ void processInput(GLFWwindow* window) {
     if (glfwGetKey(window, GLFW_KEY_ESCAPE) == GLFW_PRESS) {
         glfwSetWindowShouldClose(window, true);
     }
+    // Delete removes the obstacle under the cursor, once per press.
+    bool deleteDown = glfwGetKey(window, GLFW_KEY_DELETE) == GLFW_PRESS;
+    if (deleteDown && !deletePressed) {
+        int index = particleSystem.findObstacle(getWorldPositionFromMouse(mouseX, mouseY));
+        if (index >= 0) {
+            particleSystem.removeObstacle(index);
+            draggedObstacle = -1;
+            std::cout << "Obstacle " << index << " removed" << std::endl;
+        }
+    }
+    deletePressed = deleteDown;
 }
 
 void mouse_button_callback(GLFWwindow* window, int button, int action, int mods) {
@@ -253,6 +402,16 @@ void mouse_button_callback(GLFWwindow* window, int button, int action, int mods)
     if (button == GLFW_MOUSE_BUTTON_RIGHT) {
         rightMousePressed = (action == GLFW_PRESS);
     }
+    if (button == GLFW_MOUSE_BUTTON_MIDDLE) {
+        draggedObstacle = -1;
+        if (action == GLFW_PRESS && !ImGui::GetIO().WantCaptureMouse) {
+            glm::vec2 cursorPos = getWorldPositionFromMouse(mouseX, mouseY);
+            draggedObstacle = particleSystem.findObstacle(cursorPos);
+            if (draggedObstacle >= 0) {
+                dragOffset = particleSystem.getObstacles()[draggedObstacle].position - cursorPos;
+            }
+        }
+    }
 }
 
 void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
@@ -260,120 +419,72 @@ void cursor_position_callback(GLFWwindow* window, double xpos, double ypos) {
     mouseY = ypos;
 }
 
-void initializeParticles() {
-    for (auto& particle : particles) {
-        particle.position = glm::vec2(0.0f);
-        particle.velocity = glm::vec2(0.0f);
-        particle.lifetime = 0.0f;
-        particle.color = particleColor;
-    }
+// The wheel grows or shrinks the obstacle under the cursor.
+void scroll_callback(GLFWwindow* window, double xoffset, double yoffset) {
+    if (ImGui::GetIO().WantCaptureMouse) return;
+    int index = particleSystem.findObstacle(getWorldPositionFromMouse(mouseX, mouseY));
+    if (index < 0) return;
+    float size = particleSystem.getObstacles()[index].size * std::pow(1.1f, static_cast<float>(yoffset));
+    particleSystem.resizeObstacle(index, glm::clamp(size, 10.0f, 1000.0f));
 }
 
 glm::vec2 getWorldPositionFromMouse(double mouseX, double mouseY) {
     return glm::vec2(mouseX, mouseY);
 }
 
-void updateParticles(float deltaTime) {
-    glm::vec2 cursorPos = getWorldPositionFromMouse(mouseX, mouseY);
-
-    for (auto& particle : particles) {
-        if (particle.lifetime > 0.0f) {
-            if (rightMousePressed) {
-                glm::vec2 direction = iman ? (cursorPos - particle.position) : (particle.position - cursorPos);
-                float length = glm::length(direction);
-                if (length > 0.0f) direction /= length;
-                particle.velocity += direction * particleVelocity * deltaTime;
-            }
-
-            particle.position += particle.velocity * deltaTime;
-            particle.lifetime -= deltaTime;
-
-            for (auto& obstacle : obstacles) {
-                if (obstacle.type == 0) { // Square collision
-                    glm::vec2 min = obstacle.position - glm::vec2(obstacle.size / 2);
-                    glm::vec2 max = obstacle.position + glm::vec2(obstacle.size / 2);
-                    if (particle.position.x > min.x && particle.position.x < max.x &&
-                        particle.position.y > min.y && particle.position.y < max.y) {
-                        particle.velocity = -particle.velocity; // Bounce
-                    }
-                }
-                else if (obstacle.type == 1) { // Triangle collision
-                    glm::vec2 a = obstacle.position + glm::vec2(0, -obstacle.size / 2);
-                    glm::vec2 b = obstacle.position + glm::vec2(-obstacle.size / 2, obstacle.size / 2);
-                    glm::vec2 c = obstacle.position + glm::vec2(obstacle.size / 2, obstacle.size / 2);
-
-                    if (isPointInTriangle(particle.position, a, b, c)) {
-                        particle.velocity = -particle.velocity;
-                    }
-                }
-                else if (obstacle.type == 2) { // Circle collision
-                    float dist = glm::length(particle.position - obstacle.position);
-                    if (dist < obstacle.size / 2) {
-                        particle.velocity = -particle.velocity;
-                    }
-                }
-            }
-
-            if (particle.lifetime < 0.0f) particle.lifetime = 0.0f;
-        }
-    }
-
-    if (leftMousePressed && !ImGui::GetIO().WantCaptureMouse) {
-        glm::vec2 worldPos = getWorldPositionFromMouse(mouseX, mouseY);
-        for (auto& particle : particles) {
-            if (particle.lifetime <= 0.0f) {
-                particle.position = worldPos;
-                particle.velocity = glm::vec2(
-                    (static_cast<float>(rand()) / RAND_MAX - 0.5f) * particleVelocity,
-                    (static_cast<float>(rand()) / RAND_MAX - 0.5f) * particleVelocity
-                );
-                particle.lifetime = static_cast<float>(rand()) / RAND_MAX * particleLifetime;
-                particle.color = particleColor;
-                break;
-            }
-        }
-    }
-}
-
-void setupParticleRendering() {
-    glGenVertexArrays(1, &VAO);
-    glGenBuffers(1, &VBO);
+ParticleBatch createParticleBatch() {
+    ParticleBatch batch;
+    glGenVertexArrays(1, &batch.vao);
+    glGenBuffers(1, &batch.vbo);
 
-    glBindVertexArray(VAO);
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, particles.size() * sizeof(Particle), nullptr, GL_DYNAMIC_DRAW);
+    glBindVertexArray(batch.vao);
+    glBindBuffer(GL_ARRAY_BUFFER, batch.vbo);
+    glBufferData(GL_ARRAY_BUFFER, PARTICLE_PAGE_SIZE * sizeof(ParticleVertex), nullptr, GL_STREAM_DRAW);
 
-    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, position));
+    glVertexAttribPointer(0, 2, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (void*)offsetof(ParticleVertex, position));
     glEnableVertexAttribArray(0);
 
-    glVertexAttribPointer(1, 4, GL_FLOAT, GL_FALSE, sizeof(Particle), (void*)offsetof(Particle, color));
+    glVertexAttribPointer(1, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(ParticleVertex), (void*)offsetof(ParticleVertex, color));
     glEnableVertexAttribArray(1);
 
+    glVertexAttribPointer(2, 1, GL_FLOAT, GL_FALSE, sizeof(ParticleVertex), (void*)offsetof(ParticleVertex, lifetime));
+    glEnableVertexAttribArray(2);
+
     glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
+    return batch;
 }
 
 void renderParticles() {
     renderObstacles(); // Draw obstacles before particles
 
-    std::vector<float> particleData;
-    for (auto& particle : particles) {
-        if (particle.lifetime > 0.0f) {
-            particleData.insert(particleData.end(), {
-                particle.position.x, particle.position.y,
-                particle.color.r, particle.color.g, particle.color.b, particle.color.a
-                });
-        }
-    }
-
-    glBindBuffer(GL_ARRAY_BUFFER, VBO);
-    glBufferData(GL_ARRAY_BUFFER, particleData.size() * sizeof(float), particleData.data(), GL_DYNAMIC_DRAW);
-
     glUseProgram(shaderProgram);
     glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    // Color is applied here rather than written into the pool every frame.
+    const ParticleSettings& settings = particleSystem.getSettings();
+    setColorUniforms(settings.color, settings.colorOverLife, settings.lifetime);
+
+    // One fixed-size buffer per pool page, created the first time the page
+    // holds live particles, so growing the pool never reallocates the
+    // buffers it already has. The vertices were packed by the simulation
+    // step while the particles were still in cache.
+    int liveCount = static_cast<int>(particleVertices.size());
+    int pageCount = (liveCount + PARTICLE_PAGE_SIZE - 1) / PARTICLE_PAGE_SIZE;
+    for (int page = 0; page < pageCount; ++page) {
+        if (page == static_cast<int>(particleBatches.size())) {
+            particleBatches.push_back(createParticleBatch());
+        }
+        int live = std::min(liveCount - page * PARTICLE_PAGE_SIZE, PARTICLE_PAGE_SIZE);
+
+        // Orphan the old contents so the upload does not wait on the last draw.
+        glBindBuffer(GL_ARRAY_BUFFER, particleBatches[page].vbo);
+        glBufferData(GL_ARRAY_BUFFER, PARTICLE_PAGE_SIZE * sizeof(ParticleVertex), nullptr, GL_STREAM_DRAW);
+        glBufferSubData(GL_ARRAY_BUFFER, 0, live * sizeof(ParticleVertex), particleVertices.data() + page * PARTICLE_PAGE_SIZE);
 
-    glBindVertexArray(VAO);
-    glDrawArrays(GL_POINTS, 0, particleData.size() / 6);
+        glBindVertexArray(particleBatches[page].vao);
+        glDrawArrays(GL_POINTS, 0, live);
+    }
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
     glBindVertexArray(0);
 }
 
@@ -407,8 +518,9 @@ void renderObstacles() {
 
     glUseProgram(shaderProgram);
     glUniformMatrix4fv(glGetUniformLocation(shaderProgram, "projection"), 1, GL_FALSE, glm::value_ptr(projection));
+    setColorUniforms(glm::vec4(1.0f), ColorGradient(), 1.0f);
 
-    for (auto& obstacle : obstacles) {
+    for (auto& obstacle : particleSystem.getObstacles()) {
         float x = obstacle.position.x;
         float y = obstacle.position.y;
         float s = obstacle.size / 2;
@@ -428,6 +540,16 @@ void renderObstacles() {
                 vertices.push_back(y + sin(angle) * s);
             }
         }
+        else if (obstacle.type == OBSTACLE_POLYGON) {
+            // Concave outlines cannot be fanned, so draw the shape's cached
+            // tessellation instead.
+            const PolygonShape& shape = particleSystem.getPolygonShape(obstacle.shape);
+            for (int index : shape.triangles) {
+                glm::vec2 vertex = obstacle.position + shape.outline[index] * obstacle.size;
+                vertices.push_back(vertex.x);
+                vertices.push_back(vertex.y);
+            }
+        }
 
         glBindVertexArray(VAO);
         glBindBuffer(GL_ARRAY_BUFFER, VBO);
@@ -437,51 +559,18 @@ void renderObstacles() {
         glEnableVertexAttribArray(0);
 
         glVertexAttrib4f(1, 1.0f, 1.0f, 1.0f, 1.0f);
+        glVertexAttrib1f(2, 1.0f);
 
-        glDrawArrays(obstacle.type == 2 ? GL_TRIANGLE_FAN : GL_TRIANGLE_FAN, 0, vertices.size() / 2);
+        glDrawArrays(obstacle.type == OBSTACLE_POLYGON ? GL_TRIANGLES : GL_TRIANGLE_FAN, 0, vertices.size() / 2);
     }
 }
 
-glm::vec2 getRandomValidPosition(float size) {
-    glm::vec2 pos;
-    bool validPosition = false;
-    int maxAttempts = 100;
-
-    while (!validPosition && maxAttempts > 0) {
-        pos = glm::vec2(
-            static_cast<float>(rand() % (SCR_WIDTH - static_cast<int>(size))) + size / 2,
-            static_cast<float>(rand() % (SCR_HEIGHT - static_cast<int>(size))) + size / 2
-        );
-
-        validPosition = true;
-        for (auto& obstacle : obstacles) {
-            if (obstacle.type == 0) {
-                glm::vec2 min = obstacle.position - glm::vec2(obstacle.size / 2);
-                glm::vec2 max = obstacle.position + glm::vec2(obstacle.size / 2);
-                if (pos.x > min.x && pos.x < max.x && pos.y > min.y && pos.y < max.y) {
-                    validPosition = false;
-                    break;
-                }
-            }
-            else if (obstacle.type == 2) {
-                float dist = glm::length(pos - obstacle.position);
-                if (dist < (obstacle.size / 2 + size / 2)) {
-                    validPosition = false;
-                    break;
-                }
-            }
-        }
-        maxAttempts--;
-    }
-    return pos;
-}
-
-bool isPointInTriangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c) {
-    float area = 0.5f * (-b.y * c.x + a.y * (-b.x + c.x) + a.x * (b.y - c.y) + b.x * c.y);
-    float s = 1 / (2 * area) * (a.y * c.x - a.x * c.y + (c.y - a.y) * p.x + (a.x - c.x) * p.y);
-    float t = 1 / (2 * area) * (a.x * b.y - a.y * b.x + (a.y - b.y) * p.x + (b.x - a.x) * p.y);
-
-    return s >= 0 && t >= 0 && (s + t) <= 1;
+void setColorUniforms(glm::vec4 tint, const ColorGradient& gradient, float lifetime) {
+    glUniform4fv(glGetUniformLocation(shaderProgram, "tint"), 1, glm::value_ptr(tint));
+    glUniform1f(glGetUniformLocation(shaderProgram, "lifetime"), lifetime);
+    glUniform1i(glGetUniformLocation(shaderProgram, "stopCount"), gradient.getStopCount());
+    glUniform1fv(glGetUniformLocation(shaderProgram, "stopPositions"), gradient.getStopCount(), gradient.getPositions());
+    glUniform4fv(glGetUniformLocation(shaderProgram, "stopColors"), gradient.getStopCount(), glm::value_ptr(gradient.getColors()[0]));
 }
 
 void setupImGui(GLFWwindow* window) {
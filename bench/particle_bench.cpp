@@ -0,0 +1,656 @@
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__linux__)
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#include "barnes_hut.h"
+#include "config.h"
+#include "job_system.h"
+#include "morton_order.h"
+#include "particle_collisions.h"
+#include "particle_mesh.h"
+#include "particle_system.h"
+#include "random_stream.h"
+#include "scene_file.h"
+#include "spatial_hash.h"
+
+struct Scenario {
+    int particles;
+    int obstacles;
+    bool attract;
+    int threads;
+};
+
+struct BenchOptions {
+    int steps = 120;
+    int warmup = 20;
+    float deltaTime = 1.0f / 60.0f;
+    float obstacleSize = 60.0f;
+    float fill = 1.0f;
+    uint64_t seed = 1234;
+    float collisionRadius = 0.0f;
+    bool fluid = false;
+    int reorderInterval = 0;
+    bool vertices = false;
+    bool tiled = true;
+    // Distance-field cell size in pixels; 0 sweeps against each obstacle.
+    float fieldCellSize = 0.0f;
+    // Obstacle sizes spread log-uniformly over [size / spread, size * spread].
+    float sizeSpread = 1.0f;
+    // Moves every obstacle along a small circle each step.
+    bool movingObstacles = false;
+    // Points of the concave star every obstacle takes; 0 keeps the builtin
+    // shapes.
+    int starPoints = 0;
+    // Scene that replaces the generated obstacles and the settings, and one
+    // to save each scenario's final state to.
+    std::string loadScenePath;
+    std::string saveScenePath;
+    std::vector<Scenario> scenarios;
+};
+
+struct BenchResult {
+    double nsPerParticleStep;
+    double p50, p90, p99, max;
+    double averageLive;
+    double checksum;
+    // Per-step means of the fluid phases, in ms.
+    FluidTimings fluid;
+};
+
+static double percentile(std::vector<double> samples, double p) {
+    std::sort(samples.begin(), samples.end());
+    size_t index = static_cast<size_t>(p * (samples.size() - 1) + 0.5);
+    return samples[index];
+}
+
+static double stateChecksum(ParticleSystem& system) {
+    ParticlePool& pool = system.getPool();
+    double sum = 0.0;
+    for (int page = 0; page < pool.getLivePageCount(); ++page) {
+        ParticleColumns p = pool.getPage(page);
+        int live = std::min(pool.getLiveCount() - page * PARTICLE_PAGE_SIZE, PARTICLE_PAGE_SIZE);
+        for (int i = 0; i < live; ++i) {
+            sum += p.x[i] + p.y[i] * 0.5 + p.vx[i] * 0.25 + p.lifetime[i];
+        }
+    }
+    return sum;
+}
+
+// Turns on SPH and fills the lower left of a box, sized so the block takes
+// up 40% of it, with parcels on a lattice at the rest spacing: a dam break.
+// They outlive the run, so the refill emitter stays idle.
+static void seedFluid(ParticleSystem& system, int count) {
+    FluidSettings& fluid = system.getSettings().fluid;
+    fluid.enabled = true;
+    float spacing = fluid.restSpacing;
+    float side = std::max(std::sqrt(count * spacing * spacing * 2.5f), static_cast<float>(SCR_WIDTH));
+    fluid.boundsMin = glm::vec2(0.0f);
+    fluid.boundsMax = glm::vec2(side);
+    int columns = std::max(static_cast<int>(side * 0.5f / spacing), 1);
+
+    ParticlePool& pool = system.getPool();
+    int granted = pool.allocate(count);
+    for (int i = 0; i < granted; ++i) {
+        ParticleColumns p = pool.getPage(i >> PARTICLE_PAGE_SHIFT);
+        int entry = i & (PARTICLE_PAGE_SIZE - 1);
+        p.x[entry] = p.prevX[entry] = spacing * (0.5f + i % columns);
+        p.y[entry] = p.prevY[entry] = side - spacing * (0.5f + i / columns);
+        p.vx[entry] = 0.0f;
+        p.vy[entry] = 0.0f;
+        p.lifetime[entry] = 1.0e4f;
+        p.color[entry] = 0xffffffffu;
+    }
+}
+
+static BenchResult runScenario(const Scenario& scenario, const BenchOptions& options, JobSystem* jobs) {
+    ParticleSystem system(scenario.particles);
+    system.setJobSystem(jobs);
+    system.setSeed(options.seed);
+    system.getSettings().collisions.enabled = options.collisionRadius > 0.0f;
+    system.getSettings().collisions.radius = options.collisionRadius;
+    system.getSettings().reorder.interval = options.reorderInterval;
+    system.getSettings().tiledUpdate = options.tiled;
+    system.getSettings().obstacleField.enabled = options.fieldCellSize > 0.0f;
+    system.getSettings().obstacleField.cellSize = options.fieldCellSize;
+    glm::vec2 center(SCR_WIDTH / 2.0f, SCR_HEIGHT / 2.0f);
+    if (!options.loadScenePath.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        SceneFile scene;
+        if (!scene.open(options.loadScenePath.c_str())) {
+            std::fprintf(stderr, "cannot load scene %s\n", options.loadScenePath.c_str());
+        }
+        else {
+            auto mapped = std::chrono::steady_clock::now();
+            scene.apply(system, jobs);
+            auto applied = std::chrono::steady_clock::now();
+            std::fprintf(stderr, "loaded %zu obstacles and %d particles: open %.2f ms, apply %.2f ms\n", system.getObstacles().size(),
+                system.getLiveCount(), std::chrono::duration<double, std::milli>(mapped - start).count(),
+                std::chrono::duration<double, std::milli>(applied - mapped).count());
+        }
+    }
+    else {
+        // Mixed sizes go down in eight classes, largest first, so the big ones
+        // still find room.
+        int classes = options.sizeSpread > 1.0f ? 8 : 1;
+        int type = -1, shape = -1;
+        if (options.starPoints > 0) {
+            type = OBSTACLE_POLYGON;
+            shape = system.addPolygonShape(makeStarVertices(options.starPoints, 0.45f));
+        }
+        int placed = 0;
+        for (int c = 0; c < classes; ++c) {
+            float t = classes > 1 ? 1.0f - 2.0f * c / (classes - 1) : 0.0f;
+            float size = options.obstacleSize * std::pow(options.sizeSpread, t);
+            placed += system.placeObstacles(scenario.obstacles / classes + (c < scenario.obstacles % classes), size, type, shape);
+        }
+        if (placed < scenario.obstacles) {
+            std::fprintf(stderr, "only %d of %d obstacles fit\n", placed, scenario.obstacles);
+        }
+    }
+    std::vector<glm::vec2> anchors;
+    for (const Obstacle& obstacle : system.getObstacles()) anchors.push_back(obstacle.position);
+
+    // Every step tops the pool back up to the fill target, which is what a
+    // held-down emitter does in the viewer.
+    int target = static_cast<int>(scenario.particles * options.fill);
+    if (options.fluid) {
+        seedFluid(system, target);
+    }
+    Emitter emitter;
+    emitter.position = center;
+    emitter.rate = 0.0f;
+    emitter.setSpread(system.getSettings().velocity, system.getSettings().lifetime);
+    int refill = system.addEmitter(emitter);
+    std::vector<double> frameTimes;
+    frameTimes.reserve(options.steps);
+    double liveSum = 0.0;
+    FluidTimings fluidSum;
+    std::vector<ParticleVertex> vertices;
+    for (int step = 0; step < options.warmup + options.steps; ++step) {
+        system.getEmitter(refill).burstCount = target - system.getLiveCount();
+        auto start = std::chrono::steady_clock::now();
+        if (options.movingObstacles) {
+            for (int i = 0; i < static_cast<int>(anchors.size()); ++i) {
+                float angle = step * 0.05f + i;
+                system.moveObstacle(i, anchors[i] + 16.0f * glm::vec2(std::cos(angle), std::sin(angle)));
+            }
+        }
+        system.update(options.deltaTime, scenario.attract, true, center, options.vertices ? &vertices : nullptr, 0.5f);
+        auto end = std::chrono::steady_clock::now();
+
+        if (step >= options.warmup) {
+            frameTimes.push_back(std::chrono::duration<double, std::nano>(end - start).count());
+            liveSum += system.getLiveCount();
+            const FluidTimings& fluid = system.getFluidTimings();
+            fluidSum.neighbors += fluid.neighbors;
+            fluidSum.density += fluid.density;
+            fluidSum.forces += fluid.forces;
+            fluidSum.integrate += fluid.integrate;
+        }
+    }
+
+    if (!options.saveScenePath.empty()) {
+        auto start = std::chrono::steady_clock::now();
+        bool saved = saveScene(options.saveScenePath.c_str(), system, true);
+        auto end = std::chrono::steady_clock::now();
+        if (saved) {
+            std::fprintf(stderr, "saved %zu obstacles and %d particles in %.2f ms\n", system.getObstacles().size(), system.getLiveCount(),
+                std::chrono::duration<double, std::milli>(end - start).count());
+        }
+        else {
+            std::fprintf(stderr, "cannot save scene %s\n", options.saveScenePath.c_str());
+        }
+    }
+
+    BenchResult result;
+    double totalNs = 0.0;
+    for (double t : frameTimes) totalNs += t;
+    result.averageLive = liveSum / options.steps;
+    result.nsPerParticleStep = totalNs / (options.steps * std::max(result.averageLive, 1.0));
+    result.p50 = percentile(frameTimes, 0.50) * 1e-6;
+    result.p90 = percentile(frameTimes, 0.90) * 1e-6;
+    result.p99 = percentile(frameTimes, 0.99) * 1e-6;
+    result.max = *std::max_element(frameTimes.begin(), frameTimes.end()) * 1e-6;
+    result.checksum = stateChecksum(system);
+    result.fluid.neighbors = fluidSum.neighbors / options.steps;
+    result.fluid.density = fluidSum.density / options.steps;
+    result.fluid.forces = fluidSum.forces / options.steps;
+    result.fluid.integrate = fluidSum.integrate / options.steps;
+    return result;
+}
+
+// Direct pairwise sum in float, the O(N^2) method Barnes-Hut replaces.
+static glm::vec2 bruteAcceleration(const std::vector<float>& x, const std::vector<float>& y, glm::vec2 position, float softening) {
+    float softening2 = softening * softening;
+    float ax = 0.0f, ay = 0.0f;
+    for (size_t i = 0; i < x.size(); ++i) {
+        float dx = x[i] - position.x;
+        float dy = y[i] - position.y;
+        float r2 = dx * dx + dy * dy + softening2;
+        float scale = 1.0f / (r2 * std::sqrt(r2));
+        ax += dx * scale;
+        ay += dy * scale;
+    }
+    return glm::vec2(ax, ay);
+}
+
+// Times each solver's setup (tree build or mesh solve) and one force
+// evaluation for every body, and compares against the direct sum on a
+// sample of bodies. The direct time for all N is extrapolated from that
+// sample.
+static void runNBody(int bodies, const std::vector<float>& thetas, const std::vector<int>& meshSizes, int threads, const BenchOptions& options, JobSystem* jobs) {
+    static const int SAMPLE_SIZE = 512;
+    GravitySettings gravity;
+
+    // A few Gaussian clusters over a uniform background, so the tree is
+    // neither balanced nor degenerate.
+    RandomStream random(options.seed);
+    std::vector<float> x(bodies), y(bodies);
+    glm::vec2 clusters[4];
+    for (glm::vec2& c : clusters) c = linearRand(random, glm::vec2(200.0f), glm::vec2(SCR_WIDTH - 200.0f, SCR_HEIGHT - 200.0f));
+    for (int i = 0; i < bodies; ++i) {
+        glm::vec2 pos;
+        if (i % 4 == 0) pos = linearRand(random, glm::vec2(0.0f), glm::vec2(SCR_WIDTH, SCR_HEIGHT));
+        else pos = clusters[i % 4] + glm::vec2(gaussRand(random, 0.0f, 60.0f), gaussRand(random, 0.0f, 60.0f));
+        x[i] = pos.x;
+        y[i] = pos.y;
+    }
+
+    BarnesHutTree tree;
+    auto buildStart = std::chrono::steady_clock::now();
+    tree.build(x.data(), y.data(), bodies, jobs);
+    auto buildEnd = std::chrono::steady_clock::now();
+    double buildMs = std::chrono::duration<double, std::milli>(buildEnd - buildStart).count();
+
+    int sampleCount = std::min(bodies, SAMPLE_SIZE);
+    int sampleStride = bodies / sampleCount;
+    // Stored only so the timed loop is not optimized away.
+    std::vector<glm::vec2> direct(sampleCount);
+    auto brute = [&](int begin, int end, int) {
+        for (int s = begin; s < end; ++s) {
+            int i = s * sampleStride;
+            direct[s] = bruteAcceleration(x, y, glm::vec2(x[i], y[i]), gravity.softening);
+        }
+    };
+    auto bruteStart = std::chrono::steady_clock::now();
+    if (jobs) jobs->parallelFor(sampleCount, 8, brute);
+    else brute(0, sampleCount, 0);
+    auto bruteEnd = std::chrono::steady_clock::now();
+    double bruteMs = std::chrono::duration<double, std::milli>(bruteEnd - bruteStart).count() * bodies / sampleCount;
+
+    // Relative to the magnitude of the exact acceleration, summed in double.
+    std::vector<glm::dvec2> reference(sampleCount);
+    for (int s = 0; s < sampleCount; ++s) {
+        int i = s * sampleStride;
+        reference[s] = tree.exactAccelerationAt(glm::vec2(x[i], y[i]), gravity.softening);
+    }
+
+    std::vector<glm::vec2> acceleration(bodies);
+    auto measure = [&](const char* method, int nodes, double setupMs, const std::function<glm::vec2(glm::vec2)>& accelerationAt) {
+        auto body = [&](int begin, int end, int) {
+            for (int i = begin; i < end; ++i) {
+                acceleration[i] = accelerationAt(glm::vec2(x[i], y[i]));
+            }
+        };
+        auto forceStart = std::chrono::steady_clock::now();
+        if (jobs) jobs->parallelFor(bodies, 1024, body);
+        else body(0, bodies, 0);
+        auto forceEnd = std::chrono::steady_clock::now();
+        double forceMs = std::chrono::duration<double, std::milli>(forceEnd - forceStart).count();
+
+        double squaredSum = 0.0, maxError = 0.0;
+        for (int s = 0; s < sampleCount; ++s) {
+            glm::dvec2 exact = reference[s];
+            double error = glm::length(glm::dvec2(acceleration[s * sampleStride]) - exact) / std::max(glm::length(exact), 1e-12);
+            squaredSum += error * error;
+            maxError = std::max(maxError, error);
+        }
+
+        std::printf("%10d %9s %7d %8d %9.3f %9.3f %10.3f %9.1fx %10.2e %10.2e\n",
+            bodies, method, threads, nodes, setupMs, forceMs, bruteMs, bruteMs / (setupMs + forceMs),
+            std::sqrt(squaredSum / sampleCount), maxError);
+        std::fflush(stdout);
+    };
+
+    char method[32];
+    for (float theta : thetas) {
+        std::snprintf(method, sizeof(method), "bh %.2f", theta);
+        measure(method, tree.getNodeCount(), buildMs, [&](glm::vec2 position) {
+            return tree.accelerationAt(position, theta, gravity.softening);
+        });
+    }
+    for (int meshSize : meshSizes) {
+        ParticleMeshSolver mesh;
+        auto solveStart = std::chrono::steady_clock::now();
+        mesh.solve(x.data(), y.data(), bodies, meshSize, gravity.softening, jobs);
+        auto solveEnd = std::chrono::steady_clock::now();
+        std::snprintf(method, sizeof(method), "pm %d", mesh.getMeshSize());
+        measure(method, mesh.getMeshSize() * mesh.getMeshSize(), std::chrono::duration<double, std::milli>(solveEnd - solveStart).count(),
+            [&](glm::vec2 position) { return mesh.accelerationAt(position); });
+    }
+
+    // Solves as a simulation would, with the bodies drifting and spreading
+    // a little every step, to show how often the mesh rebuilds its kernel.
+    static const int DRIFT_STEPS = 30;
+    std::vector<float> driftX(bodies), driftY(bodies);
+    for (int meshSize : meshSizes) {
+        ParticleMeshSolver mesh;
+        double solveMs = 0.0;
+        for (int step = 0; step < DRIFT_STEPS; ++step) {
+            float spread = 1.0f + 0.005f * step;
+            for (int i = 0; i < bodies; ++i) {
+                driftX[i] = SCR_WIDTH * 0.5f + (x[i] - SCR_WIDTH * 0.5f) * spread + 2.0f * step;
+                driftY[i] = SCR_HEIGHT * 0.5f + (y[i] - SCR_HEIGHT * 0.5f) * spread;
+            }
+            auto solveStart = std::chrono::steady_clock::now();
+            mesh.solve(driftX.data(), driftY.data(), bodies, meshSize, gravity.softening, jobs);
+            solveMs += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - solveStart).count();
+        }
+        std::snprintf(method, sizeof(method), "pm %d", mesh.getMeshSize());
+        std::printf("%10d %9s %7d drifting: %d solves, %.3f ms each, %d kernel builds\n",
+            bodies, method, threads, DRIFT_STEPS, solveMs / DRIFT_STEPS, mesh.getKernelBuildCount());
+        std::fflush(stdout);
+    }
+}
+
+// Counts one hardware event in user space on the calling thread through
+// perf_event_open. Where that is unavailable (other platforms, VMs without
+// a PMU, perf_event_paranoid above 2) isValid() is false.
+class PerfCounter {
+public:
+    PerfCounter(uint32_t type, uint64_t config) : fd(-1) {
+#if defined(__linux__)
+        perf_event_attr attr;
+        std::memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        attr.type = type;
+        attr.config = config;
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        fd = static_cast<int>(syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+        (void)type;
+        (void)config;
+#endif
+    }
+    ~PerfCounter() {
+#if defined(__linux__)
+        if (fd >= 0) close(fd);
+#endif
+    }
+    PerfCounter(const PerfCounter&) = delete;
+    PerfCounter& operator=(const PerfCounter&) = delete;
+
+    bool isValid() const { return fd >= 0; }
+
+    void start() {
+#if defined(__linux__)
+        if (fd < 0) return;
+        ioctl(fd, PERF_EVENT_IOC_RESET, 0);
+        ioctl(fd, PERF_EVENT_IOC_ENABLE, 0);
+#endif
+    }
+
+    // Events since start().
+    double stop() {
+#if defined(__linux__)
+        if (fd < 0) return 0.0;
+        ioctl(fd, PERF_EVENT_IOC_DISABLE, 0);
+        uint64_t value = 0;
+        if (read(fd, &value, sizeof(value)) != sizeof(value)) return 0.0;
+        return static_cast<double>(value);
+#else
+        return 0.0;
+#endif
+    }
+
+private:
+    int fd;
+};
+
+// Runs the neighbor (spatial hash build) and collision passes over
+// particles in random slot order, which is where spawning and compaction
+// drift to, then again after a Morton sort, counting time and cache misses
+// per particle and pass. Everything runs on the calling thread, which is
+// all the counters see.
+static void runLocality(int particles, const BenchOptions& options) {
+    static const int REPEATS = 10;
+#if defined(__linux__)
+    PerfCounter lastLevel(PERF_TYPE_HARDWARE, PERF_COUNT_HW_CACHE_MISSES);
+    PerfCounter firstLevel(PERF_TYPE_HW_CACHE,
+        PERF_COUNT_HW_CACHE_L1D | (PERF_COUNT_HW_CACHE_OP_READ << 8) | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16));
+#else
+    PerfCounter lastLevel(0, 0);
+    PerfCounter firstLevel(0, 0);
+#endif
+
+    // About one particle per collision cell.
+    ParticleCollisionSettings collisions;
+    collisions.enabled = true;
+    collisions.radius = options.collisionRadius > 0.0f ? options.collisionRadius : 2.0f;
+    float diameter = 2.0f * collisions.radius;
+    float side = std::sqrt(static_cast<float>(particles)) * diameter;
+
+    for (bool sorted : { false, true }) {
+        ParticlePool pool(particles);
+        int granted = pool.allocate(particles);
+        RandomStream random(options.seed);
+        for (int i = 0; i < granted; ++i) {
+            ParticleColumns p = pool.getPage(i >> PARTICLE_PAGE_SHIFT);
+            int entry = i & (PARTICLE_PAGE_SIZE - 1);
+            p.x[entry] = p.prevX[entry] = random.uniform(0.0f, side);
+            p.y[entry] = p.prevY[entry] = random.uniform(0.0f, side);
+            p.vx[entry] = random.uniform(-50.0f, 50.0f);
+            p.vy[entry] = random.uniform(-50.0f, 50.0f);
+            p.lifetime[entry] = 1.0e4f;
+            p.color[entry] = 0xffffffffu;
+        }
+        double sortMs = 0.0;
+        if (sorted) {
+            MortonSorter sorter;
+            auto start = std::chrono::steady_clock::now();
+            sorter.sort(pool, diameter);
+            sortMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        }
+
+        SpatialHash hash;
+        auto measure = [&](const char* pass, const std::function<void()>& body) {
+            body();
+            double ms = 0.0, lastLevelMisses = 0.0, firstLevelMisses = 0.0;
+            for (int r = 0; r < REPEATS; ++r) {
+                lastLevel.start();
+                firstLevel.start();
+                auto start = std::chrono::steady_clock::now();
+                body();
+                auto end = std::chrono::steady_clock::now();
+                firstLevelMisses += firstLevel.stop();
+                lastLevelMisses += lastLevel.stop();
+                ms += std::chrono::duration<double, std::milli>(end - start).count();
+            }
+            double perParticle = 1.0 / (static_cast<double>(REPEATS) * std::max(granted, 1));
+            std::printf("%10d %8s %9s %9.3f %9.3f", granted, sorted ? "morton" : "spawn", pass, sortMs, ms / REPEATS);
+            if (firstLevel.isValid()) std::printf(" %12.3f", firstLevelMisses * perParticle);
+            else std::printf(" %12s", "n/a");
+            if (lastLevel.isValid()) std::printf(" %12.3f", lastLevelMisses * perParticle);
+            else std::printf(" %12s", "n/a");
+            std::printf("\n");
+            std::fflush(stdout);
+        };
+        measure("neighbors", [&]() { hash.build(pool, diameter); });
+        // Includes its own hash build.
+        measure("collide", [&]() { collideParticles(pool, hash, collisions); });
+    }
+}
+
+static void printUsage(const char* program) {
+    std::printf(
+        "usage: %s [options]\n"
+        "  --particles N     pool size (repeatable, default 10000,100000)\n"
+        "  --obstacles M     obstacle count (repeatable, default 0,8,64)\n"
+        "  --obstacle-size S obstacle edge length / diameter (default 60)\n"
+        "  --attract on|off|both   cursor force at the screen center (default both)\n"
+        "  --fill F          fraction of the pool kept alive (default 1.0)\n"
+        "  --threads T       worker threads including the caller (repeatable, default 1)\n"
+        "  --steps S         measured steps per scenario (default 120)\n"
+        "  --warmup W        unmeasured steps per scenario (default 20)\n"
+        "  --dt SECONDS      step length (default 1/60)\n"
+        "  --seed SEED       simulation random seed (default 1234)\n"
+        "  --collide R       particle-particle collisions with radius R (default off)\n"
+        "  --fluid           SPH dam break instead of the emitter; adds a per-step\n"
+        "                    breakdown of the fluid phases in ms\n"
+        "  --nbody N         compare Barnes-Hut and particle-mesh gravity against the\n"
+        "                    direct O(N^2) sum for N bodies instead of running the\n"
+        "                    scenarios (repeatable)\n"
+        "  --theta T         Barnes-Hut opening angle for --nbody (repeatable, default 0.3,0.5,0.8)\n"
+        "  --mesh G          particle-mesh nodes per side for --nbody (repeatable, default 256,512)\n"
+        "  --reorder K       Morton-sort the pool every K updates (default off)\n"
+        "  --vertices        pack render vertices every step, as the viewer does\n"
+        "  --untiled         run the step, compaction and packing as separate passes\n"
+        "  --size-spread K   obstacle sizes spread log-uniformly from S/K to S*K\n"
+        "                    (default 1)\n"
+        "  --moving          move every obstacle along a small circle each step\n"
+        "  --polygon N       make every obstacle an N-point concave star polygon\n"
+        "  --save-scene FILE save each scenario's final state, particles included\n"
+        "  --load-scene FILE start each scenario from a saved scene instead of\n"
+        "                    generated obstacles; its settings replace the options'\n"
+        "  --scene-text FILE print a saved scene as text instead of running the\n"
+        "                    scenarios\n"
+        "  --field C         collide with a distance field of the obstacles sampled\n"
+        "                    every C pixels instead of sweeping against each one\n"
+        "  --locality N      time the neighbor and collision passes over N particles\n"
+        "                    in spawn order and Morton order, with L1D and last-level\n"
+        "                    cache misses per particle where perf counters are\n"
+        "                    available, instead of running the scenarios (repeatable)\n",
+        program);
+}
+
+int main(int argc, char** argv) {
+    BenchOptions options;
+    std::vector<int> particleCounts, obstacleCounts, threadCounts, bodyCounts, localityCounts;
+    std::vector<float> thetas;
+    std::vector<int> meshSizes;
+    std::vector<bool> attractModes = { false, true };
+    std::string textScenePath;
+
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        bool hasValue = i + 1 < argc;
+        if (arg == "--particles" && hasValue) particleCounts.push_back(std::atoi(argv[++i]));
+        else if (arg == "--obstacles" && hasValue) obstacleCounts.push_back(std::atoi(argv[++i]));
+        else if (arg == "--threads" && hasValue) threadCounts.push_back(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--steps" && hasValue) options.steps = std::max(1, std::atoi(argv[++i]));
+        else if (arg == "--warmup" && hasValue) options.warmup = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--obstacle-size" && hasValue) options.obstacleSize = std::max(1.0f, static_cast<float>(std::atof(argv[++i])));
+        else if (arg == "--fill" && hasValue) options.fill = glm::clamp(static_cast<float>(std::atof(argv[++i])), 0.0f, 1.0f);
+        else if (arg == "--dt" && hasValue) options.deltaTime = static_cast<float>(std::atof(argv[++i]));
+        else if (arg == "--collide" && hasValue) options.collisionRadius = std::max(0.0f, static_cast<float>(std::atof(argv[++i])));
+        else if (arg == "--fluid") options.fluid = true;
+        else if (arg == "--vertices") options.vertices = true;
+        else if (arg == "--untiled") options.tiled = false;
+        else if (arg == "--size-spread" && hasValue) options.sizeSpread = std::max(1.0f, static_cast<float>(std::atof(argv[++i])));
+        else if (arg == "--moving") options.movingObstacles = true;
+        else if (arg == "--save-scene" && hasValue) options.saveScenePath = argv[++i];
+        else if (arg == "--load-scene" && hasValue) options.loadScenePath = argv[++i];
+        else if (arg == "--scene-text" && hasValue) textScenePath = argv[++i];
+        else if (arg == "--polygon" && hasValue) options.starPoints = std::max(3, std::atoi(argv[++i]));
+        else if (arg == "--field" && hasValue) options.fieldCellSize = std::max(0.0f, static_cast<float>(std::atof(argv[++i])));
+        else if (arg == "--nbody" && hasValue) bodyCounts.push_back(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--mesh" && hasValue) meshSizes.push_back(std::max(8, std::atoi(argv[++i])));
+        else if (arg == "--theta" && hasValue) thetas.push_back(std::max(0.0f, static_cast<float>(std::atof(argv[++i]))));
+        else if (arg == "--reorder" && hasValue) options.reorderInterval = std::max(0, std::atoi(argv[++i]));
+        else if (arg == "--locality" && hasValue) localityCounts.push_back(std::max(1, std::atoi(argv[++i])));
+        else if (arg == "--seed" && hasValue) options.seed = std::strtoull(argv[++i], nullptr, 10);
+        else if (arg == "--attract" && hasValue) {
+            std::string mode = argv[++i];
+            if (mode == "on") attractModes = { true };
+            else if (mode == "off") attractModes = { false };
+            else attractModes = { false, true };
+        }
+        else {
+            printUsage(argv[0]);
+            return arg == "--help" || arg == "-h" ? 0 : 1;
+        }
+    }
+
+    if (!textScenePath.empty()) {
+        SceneFile scene;
+        if (!scene.open(textScenePath.c_str())) {
+            std::fprintf(stderr, "cannot load scene %s\n", textScenePath.c_str());
+            return 1;
+        }
+        scene.writeText(stdout);
+        return 0;
+    }
+
+    if (threadCounts.empty()) threadCounts = { 1 };
+    if (!bodyCounts.empty()) {
+        if (thetas.empty()) thetas = { 0.3f, 0.5f, 0.8f };
+        if (meshSizes.empty()) meshSizes = { 256, 512 };
+        std::printf("%10s %9s %7s %8s %9s %9s %10s %10s %10s %10s\n",
+            "bodies", "method", "threads", "nodes", "setup ms", "force ms", "direct ms", "speedup", "rms error", "max error");
+        for (int bodies : bodyCounts) {
+            for (int threads : threadCounts) {
+                std::unique_ptr<JobSystem> jobs;
+                if (threads > 1) jobs = std::make_unique<JobSystem>(threads);
+                runNBody(bodies, thetas, meshSizes, threads, options, jobs.get());
+            }
+        }
+        return 0;
+    }
+
+    if (!localityCounts.empty()) {
+        std::printf("%10s %8s %9s %9s %9s %12s %12s\n", "particles", "order", "pass", "sort ms", "pass ms", "L1D miss/p", "LLC miss/p");
+        for (int particles : localityCounts) {
+            runLocality(particles, options);
+        }
+        return 0;
+    }
+
+    if (particleCounts.empty()) particleCounts = { 10000, 100000 };
+    if (obstacleCounts.empty()) obstacleCounts = { 0, 8, 64 };
+    for (int particles : particleCounts) {
+        for (int obstacles : obstacleCounts) {
+            for (bool attract : attractModes) {
+                for (int threads : threadCounts) {
+                    options.scenarios.push_back({ particles, obstacles, attract, threads });
+                }
+            }
+        }
+    }
+
+    std::printf("%10s %9s %7s %7s %10s %12s %9s %9s %9s %9s %16s",
+        "particles", "obstacles", "attract", "threads", "live", "ns/p/step", "p50 ms", "p90 ms", "p99 ms", "max ms", "checksum");
+    if (options.fluid) std::printf(" %9s %9s %9s %9s", "neighbors", "density", "forces", "integrate");
+    std::printf("\n");
+    for (const Scenario& scenario : options.scenarios) {
+        // A single thread runs the plain serial path.
+        std::unique_ptr<JobSystem> jobs;
+        if (scenario.threads > 1) jobs = std::make_unique<JobSystem>(scenario.threads);
+        BenchResult result = runScenario(scenario, options, jobs.get());
+        std::printf("%10d %9d %7s %7d %10.0f %12.2f %9.3f %9.3f %9.3f %9.3f %16.4f",
+            scenario.particles, scenario.obstacles, scenario.attract ? "on" : "off", scenario.threads, result.averageLive,
+            result.nsPerParticleStep, result.p50, result.p90, result.p99, result.max, result.checksum);
+        if (options.fluid) {
+            std::printf(" %9.3f %9.3f %9.3f %9.3f", result.fluid.neighbors, result.fluid.density, result.fluid.forces, result.fluid.integrate);
+        }
+        std::printf("\n");
+        std::fflush(stdout);
+    }
+    return 0;
+}
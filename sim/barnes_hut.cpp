@@ -0,0 +1,239 @@
+#include "barnes_hut.h"
+#include <algorithm>
+#include <cmath>
+#include "morton_order.h"
+
+// Bodies per leaf before a node is split.
+static const int LEAF_SIZE = 8;
+
+// Morton codes have 16 bits per axis, so nodes at this level cannot be
+// split any further.
+static const int MAX_LEVEL = 16;
+
+// Level whose nodes become the roots of the subtrees built in parallel;
+// up to 4^3 = 64 jobs.
+static const int PARALLEL_LEVEL = 3;
+
+// Below this many bodies the tree is built on the calling thread.
+static const int PARALLEL_BUILD_MIN = 8192;
+
+// Traversal stack: at most three siblings wait per level on the way down.
+static const int STACK_SIZE = 4 * MAX_LEVEL;
+
+void BarnesHutTree::build(const ParticlePool& pool, JobSystem* jobs) {
+    // Between fluid substeps, slots that expired are still below the live
+    // count, since compaction only runs after the last substep. Only live
+    // particles are copied; every slot is written and the count advances
+    // past the live ones only.
+    std::vector<float> x(pool.getLiveCount()), y(pool.getLiveCount());
+    int count = 0;
+    for (int page = 0; page < pool.getLivePageCount(); ++page) {
+        ParticleColumns p = pool.getPage(page);
+        int live = std::min(pool.getLiveCount() - page * PARTICLE_PAGE_SIZE, PARTICLE_PAGE_SIZE);
+        for (int i = 0; i < live; ++i) {
+            x[count] = p.x[i];
+            y[count] = p.y[i];
+            count += p.lifetime[i] > 0.0f;
+        }
+    }
+    build(x.data(), y.data(), count, jobs);
+}
+
+void BarnesHutTree::build(const float* x, const float* y, int count, JobSystem* jobs) {
+    nodes.clear();
+    bodyX.resize(count);
+    bodyY.resize(count);
+    codes.resize(count);
+    if (count == 0) return;
+
+    glm::vec2 minBound(x[0], y[0]), maxBound(x[0], y[0]);
+    for (int i = 1; i < count; ++i) {
+        minBound = glm::min(minBound, glm::vec2(x[i], y[i]));
+        maxBound = glm::max(maxBound, glm::vec2(x[i], y[i]));
+    }
+    rootSize = std::max(std::max(maxBound.x - minBound.x, maxBound.y - minBound.y), 1.0f);
+    float scale = 65535.0f / rootSize;
+
+    // Sort the bodies by Morton code.
+    std::vector<uint32_t> key(count);
+    std::vector<int> order;
+    for (int i = 0; i < count; ++i) {
+        uint32_t qx = static_cast<uint32_t>(std::min((x[i] - minBound.x) * scale, 65535.0f));
+        uint32_t qy = static_cast<uint32_t>(std::min((y[i] - minBound.y) * scale, 65535.0f));
+        key[i] = encodeMorton(qx, qy);
+    }
+    radixSortByKey(key, order, 32, jobs);
+    for (int i = 0; i < count; ++i) {
+        bodyX[i] = x[order[i]];
+        bodyY[i] = y[order[i]];
+    }
+    codes.swap(key);
+
+    nodes.resize(1);
+    if (!jobs || count < PARALLEL_BUILD_MIN) {
+        buildNode(nodes, 0, 0, count, 0, nullptr);
+        return;
+    }
+
+    // Build the top levels here, then the subtrees under them as jobs into
+    // their own arrays, which are appended afterwards.
+    std::vector<Subtree> subtrees;
+    buildNode(nodes, 0, 0, count, 0, &subtrees);
+    int topCount = getNodeCount();
+
+    std::vector<std::vector<Node>> built(subtrees.size());
+    jobs->parallelFor(static_cast<int>(subtrees.size()), 1, [&](int begin, int end, int) {
+        for (int s = begin; s < end; ++s) {
+            built[s].resize(1);
+            buildNode(built[s], 0, subtrees[s].begin, subtrees[s].end, subtrees[s].level, nullptr);
+        }
+    });
+
+    std::vector<bool> done(topCount, false);
+    for (size_t s = 0; s < subtrees.size(); ++s) {
+        // Local index k > 0 lands at offset + k.
+        int offset = getNodeCount() - 1;
+        for (size_t k = 0; k < built[s].size(); ++k) {
+            Node node = built[s][k];
+            if (node.childCount > 0) node.firstChild += offset;
+            if (k == 0) nodes[subtrees[s].node] = node;
+            else nodes.push_back(node);
+        }
+        done[subtrees[s].node] = true;
+    }
+
+    // Parents come before their children, so walking backwards sees every
+    // child finished before its parent.
+    for (int i = topCount - 1; i >= 0; --i) {
+        if (nodes[i].childCount > 0 && !done[i]) summarize(nodes[i], nodes);
+    }
+}
+
+void BarnesHutTree::buildNode(std::vector<Node>& out, int index, int begin, int end, int level, std::vector<Subtree>* deferred) const {
+    Node node;
+    node.size = std::ldexp(rootSize, -level);
+    node.firstChild = -1;
+    node.childCount = 0;
+    node.begin = begin;
+    node.end = end;
+
+    if (end - begin <= LEAF_SIZE || level == MAX_LEVEL) {
+        float sumX = 0.0f, sumY = 0.0f;
+        for (int i = begin; i < end; ++i) {
+            sumX += bodyX[i];
+            sumY += bodyY[i];
+        }
+        node.mass = static_cast<float>(end - begin);
+        node.centerX = sumX / node.mass;
+        node.centerY = sumY / node.mass;
+        out[index] = node;
+        return;
+    }
+
+    if (deferred && level == PARALLEL_LEVEL) {
+        out[index] = node;
+        deferred->push_back({ index, begin, end, level });
+        return;
+    }
+
+    // Codes in the range share their top 2 * level bits, so the next two
+    // bits pick the quadrant and are sorted too.
+    int shift = 30 - 2 * level;
+    int bounds[5];
+    bounds[0] = begin;
+    bounds[4] = end;
+    for (int q = 1; q < 4; ++q) {
+        bounds[q] = static_cast<int>(std::partition_point(codes.begin() + bounds[q - 1], codes.begin() + end,
+            [&](uint32_t code) { return static_cast<int>((code >> shift) & 3) < q; }) - codes.begin());
+    }
+
+    node.firstChild = static_cast<int>(out.size());
+    for (int q = 0; q < 4; ++q) {
+        if (bounds[q] < bounds[q + 1]) node.childCount++;
+    }
+    out.resize(out.size() + node.childCount);
+    out[index] = node;
+
+    int child = node.firstChild;
+    for (int q = 0; q < 4; ++q) {
+        if (bounds[q] < bounds[q + 1]) buildNode(out, child++, bounds[q], bounds[q + 1], level + 1, deferred);
+    }
+    if (!deferred) summarize(out[index], out);
+}
+
+void BarnesHutTree::summarize(Node& node, const std::vector<Node>& from) const {
+    float mass = 0.0f, sumX = 0.0f, sumY = 0.0f;
+    for (int c = node.firstChild; c < node.firstChild + node.childCount; ++c) {
+        mass += from[c].mass;
+        sumX += from[c].centerX * from[c].mass;
+        sumY += from[c].centerY * from[c].mass;
+    }
+    node.mass = mass;
+    node.centerX = sumX / mass;
+    node.centerY = sumY / mass;
+}
+
+glm::vec2 BarnesHutTree::accelerationAt(glm::vec2 position, float theta, float softening) const {
+    if (nodes.empty()) return glm::vec2(0.0f);
+    float theta2 = theta * theta;
+    float softening2 = softening * softening;
+    float ax = 0.0f, ay = 0.0f;
+
+    int stack[STACK_SIZE];
+    int top = 0;
+    stack[top++] = 0;
+    while (top > 0) {
+        const Node& node = nodes[stack[--top]];
+        float dx = node.centerX - position.x;
+        float dy = node.centerY - position.y;
+        float distance2 = dx * dx + dy * dy;
+
+        if (node.size * node.size < theta2 * distance2) {
+            float r2 = distance2 + softening2;
+            float scale = node.mass / (r2 * std::sqrt(r2));
+            ax += dx * scale;
+            ay += dy * scale;
+        }
+        else if (node.childCount == 0) {
+            for (int i = node.begin; i < node.end; ++i) {
+                float bx = bodyX[i] - position.x;
+                float by = bodyY[i] - position.y;
+                float r2 = bx * bx + by * by + softening2;
+                float scale = 1.0f / (r2 * std::sqrt(r2));
+                ax += bx * scale;
+                ay += by * scale;
+            }
+        }
+        else {
+            for (int c = node.firstChild + node.childCount - 1; c >= node.firstChild; --c) {
+                stack[top++] = c;
+            }
+        }
+    }
+    return glm::vec2(ax, ay);
+}
+
+glm::vec2 BarnesHutTree::exactAccelerationAt(glm::vec2 position, float softening) const {
+    float softening2 = softening * softening;
+    double ax = 0.0, ay = 0.0;
+    for (int i = 0, count = getBodyCount(); i < count; ++i) {
+        double bx = bodyX[i] - position.x;
+        double by = bodyY[i] - position.y;
+        double r2 = bx * bx + by * by + softening2;
+        double scale = 1.0 / (r2 * std::sqrt(r2));
+        ax += bx * scale;
+        ay += by * scale;
+    }
+    return glm::vec2(static_cast<float>(ax), static_cast<float>(ay));
+}
+
+void applyGravity(const ParticleColumns& p, const BarnesHutTree& tree, const GravitySettings& settings, float deltaTime) {
+    float impulse = settings.strength * deltaTime;
+    if (impulse == 0.0f) return;
+    for (int i = 0, count = p.count; i < count; ++i) {
+        if (p.lifetime[i] <= 0.0f) continue;
+        glm::vec2 acceleration = tree.accelerationAt(glm::vec2(p.x[i], p.y[i]), settings.theta, settings.softening);
+        p.vx[i] += acceleration.x * impulse;
+        p.vy[i] += acceleration.y * impulse;
+    }
+}
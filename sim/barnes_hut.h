@@ -0,0 +1,60 @@
+#ifndef BARNES_HUT_H
+#define BARNES_HUT_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "gravity.h"
+#include "job_system.h"
+#include "particle_pool.h"
+
+// Barnes-Hut quadtree over a set of bodies, rebuilt from scratch each step.
+// Bodies are sorted along a Morton curve so every node owns a contiguous
+// range of them; leaves hold up to a handful of bodies. The levels below
+// the top few are independent subtrees, which build() spreads over jobs.
+class BarnesHutTree {
+public:
+    // Builds over the live particles of pool.
+    void build(const ParticlePool& pool, JobSystem* jobs = nullptr);
+    void build(const float* x, const float* y, int count, JobSystem* jobs = nullptr);
+
+    // Acceleration at position per unit of GravitySettings::strength.
+    glm::vec2 accelerationAt(glm::vec2 position, float theta, float softening) const;
+    // The same, summed over every body; O(N), for reference.
+    glm::vec2 exactAccelerationAt(glm::vec2 position, float softening) const;
+
+    int getBodyCount() const { return static_cast<int>(bodyX.size()); }
+    int getNodeCount() const { return static_cast<int>(nodes.size()); }
+
+private:
+    // Children of a node are stored next to each other; a leaf has none
+    // and owns bodies [begin, end).
+    struct Node {
+        float centerX, centerY;
+        float mass;
+        float size;
+        int firstChild;
+        int childCount;
+        int begin, end;
+    };
+
+    struct Subtree {
+        int node;
+        int begin, end;
+        int level;
+    };
+
+    void buildNode(std::vector<Node>& out, int index, int begin, int end, int level, std::vector<Subtree>* deferred) const;
+    void summarize(Node& node, const std::vector<Node>& from) const;
+
+    std::vector<Node> nodes;
+    std::vector<float> bodyX, bodyY;
+    std::vector<uint32_t> codes;
+    float rootSize;
+};
+
+// Adds strength * acceleration * deltaTime to the velocity of every live
+// particle in p.
+void applyGravity(const ParticleColumns& p, const BarnesHutTree& tree, const GravitySettings& settings, float deltaTime);
+
+#endif // !BARNES_HUT_H
@@ -0,0 +1,502 @@
+#include "collision_kernels.h"
+#include <cfloat>
+#include <cmath>
+
+// Bounces resolved per particle and step; a particle still hitting
+// something after that stops at its last impact point.
+static const int MAX_BOUNCES = 4;
+
+// How far a bounced particle is pushed off the surface, in pixels, so the
+// next sweep does not hit the same surface at t = 0.
+static const float SURFACE_OFFSET = 1e-2f;
+
+// Particles per block in the bounds pass.
+static const int COLLISION_BLOCK = 512;
+
+// Most obstacles a run of particles is checked against as a list.
+static const int NEAR_OBSTACLES = 64;
+
+// Shortest run of particles split further when more obstacles than that are
+// near it. A multiple of PARTICLE_SIMD_WIDTH, so runs stay aligned.
+static const int MIN_NEAR_RUN = 32;
+
+struct Segment {
+    glm::vec2 start, delta;
+    glm::vec2 min, max;
+
+    Segment(glm::vec2 start, glm::vec2 delta) : start(start), delta(delta),
+        min(glm::min(start, start + delta)), max(glm::max(start, start + delta)) {}
+
+    bool overlaps(float minX, float minY, float maxX, float maxY) const {
+        return (min.x <= maxX) & (max.x >= minX) & (min.y <= maxY) & (max.y >= minY);
+    }
+};
+
+struct Hit {
+    float t;
+    glm::vec2 normal;
+};
+
+// Each sweep tests start + delta * t for t in [0, hit.t) and replaces hit if
+// the obstacle is entered earlier. Most segments miss most obstacles, so the
+// bounds are checked first.
+static void sweepSquare(const SquareColliders& squares, int j, const Segment& segment, Hit& hit) {
+    float minX = squares.minX[j], minY = squares.minY[j];
+    float maxX = squares.maxX[j], maxY = squares.maxY[j];
+    if (!segment.overlaps(minX, minY, maxX, maxY)) return;
+    glm::vec2 start = segment.start, delta = segment.delta;
+    if (start.x > minX && start.x < maxX && start.y > minY && start.y < maxY) return;
+
+    // enter starts below zero so that a start point on an edge still picks
+    // up that edge's normal.
+    float enter = -1.0f, exit = hit.t;
+    glm::vec2 normal(0.0f);
+    if (delta.x != 0.0f) {
+        float t0 = (minX - start.x) / delta.x, t1 = (maxX - start.x) / delta.x;
+        float entry = delta.x > 0.0f ? t0 : t1, leave = delta.x > 0.0f ? t1 : t0;
+        if (entry > enter) {
+            enter = entry;
+            normal = glm::vec2(delta.x > 0.0f ? -1.0f : 1.0f, 0.0f);
+        }
+        if (leave < exit) exit = leave;
+    }
+    else if (start.x <= minX || start.x >= maxX) {
+        return;
+    }
+    if (delta.y != 0.0f) {
+        float t0 = (minY - start.y) / delta.y, t1 = (maxY - start.y) / delta.y;
+        float entry = delta.y > 0.0f ? t0 : t1, leave = delta.y > 0.0f ? t1 : t0;
+        if (entry > enter) {
+            enter = entry;
+            normal = glm::vec2(0.0f, delta.y > 0.0f ? -1.0f : 1.0f);
+        }
+        if (leave < exit) exit = leave;
+    }
+    else if (start.y <= minY || start.y >= maxY) {
+        return;
+    }
+
+    // The box is open, so merely touching an edge or corner is not a hit.
+    if (enter >= 0.0f && enter < exit && enter < hit.t) {
+        hit.t = enter;
+        hit.normal = normal;
+    }
+}
+
+static void sweepTriangle(const TriangleColliders& triangles, int j, const Segment& segment, Hit& hit) {
+    if (!segment.overlaps(triangles.minX[j], triangles.minY[j], triangles.maxX[j], triangles.maxY[j])) return;
+    glm::vec2 start = segment.start, delta = segment.delta;
+    const float nx[3] = { triangles.nx0[j], triangles.nx1[j], triangles.nx2[j] };
+    const float ny[3] = { triangles.ny0[j], triangles.ny1[j], triangles.ny2[j] };
+    const float d[3] = { triangles.d0[j], triangles.d1[j], triangles.d2[j] };
+
+    // Clip the segment against the three inside half-planes; the last edge
+    // it crosses on the way in is the one it hit.
+    float enter = -1.0f, exit = hit.t;
+    int entered = -1;
+    for (int k = 0; k < 3; ++k) {
+        float distance = nx[k] * start.x + ny[k] * start.y + d[k];
+        float rate = nx[k] * delta.x + ny[k] * delta.y;
+        if (rate > 0.0f) {
+            float t = -distance / rate;
+            if (t > enter) {
+                enter = t;
+                entered = k;
+            }
+        }
+        else if (rate < 0.0f) {
+            float t = -distance / rate;
+            if (t < exit) exit = t;
+        }
+        else if (distance < 0.0f) {
+            return;
+        }
+        if (enter > exit) return;
+    }
+
+    // A start point inside leaves enter negative.
+    if (entered >= 0 && enter >= 0.0f && enter < hit.t) {
+        hit.t = enter;
+        hit.normal = glm::vec2(-nx[entered], -ny[entered]);
+    }
+}
+
+static void sweepCircle(const CircleColliders& circles, int j, const Segment& segment, Hit& hit) {
+    float cx = circles.x[j], cy = circles.y[j], radius = circles.radius[j];
+    if (!segment.overlaps(cx - radius, cy - radius, cx + radius, cy + radius)) return;
+    glm::vec2 delta = segment.delta;
+    glm::vec2 offset = segment.start - glm::vec2(cx, cy);
+    float b = glm::dot(offset, delta);
+    float c = glm::dot(offset, offset) - circles.radiusSquared[j];
+    // Starting inside, or moving away from the center.
+    if (c < 0.0f || b >= 0.0f) return;
+
+    float a = glm::dot(delta, delta);
+    float discriminant = b * b - a * c;
+    if (discriminant <= 0.0f) return;
+    float t = (-b - std::sqrt(discriminant)) / a;
+    if (t < hit.t) {
+        hit.t = t;
+        hit.normal = glm::normalize(offset + delta * t);
+    }
+}
+
+// Only edges the segment crosses from their outer side can stop it, so a
+// concave outline needs no decomposition, and a particle that starts
+// inside is let out. Chunks of edges are skipped by their bounds.
+static void sweepPolygon(const PolygonColliders& polygons, int j, const Segment& segment, Hit& hit) {
+    if (!segment.overlaps(polygons.minX[j], polygons.minY[j], polygons.maxX[j], polygons.maxY[j])) return;
+    glm::vec2 start = segment.start, delta = segment.delta;
+    int first = polygons.firstEdge[j], end = first + polygons.edgeCount[j];
+    for (int chunk = first; chunk < end; chunk += POLYGON_EDGE_CHUNK) {
+        int c = chunk / POLYGON_EDGE_CHUNK;
+        if (!segment.overlaps(polygons.chunkMinX[c], polygons.chunkMinY[c], polygons.chunkMaxX[c], polygons.chunkMaxY[c])) continue;
+        for (int k = chunk, last = chunk + POLYGON_EDGE_CHUNK < end ? chunk + POLYGON_EDGE_CHUNK : end; k < last; ++k) {
+            float nx = polygons.nx[k], ny = polygons.ny[k];
+            float rate = nx * delta.x + ny * delta.y;
+            if (rate >= 0.0f) continue;
+            float ox = start.x - polygons.x[k], oy = start.y - polygons.y[k];
+            float distance = nx * ox + ny * oy;
+            if (distance < 0.0f) continue;
+            float t = -distance / rate;
+            if (t >= hit.t) continue;
+            // The crossing has to lie on the edge, not just on its line.
+            float ex = polygons.dx[k], ey = polygons.dy[k];
+            float along = (ox + delta.x * t) * ex + (oy + delta.y * t) * ey;
+            if (along < 0.0f || along > ex * ex + ey * ey) continue;
+            hit.t = t;
+            hit.normal = glm::vec2(nx, ny);
+        }
+    }
+}
+
+// The TYPES template parameter is an ObstacleTypeMask; the loops over types
+// outside it are compiled out.
+template <unsigned TYPES>
+static void sweepAll(const ObstacleColliders& colliders, const Segment& segment, Hit& hit) {
+    if (TYPES & OBSTACLE_MASK_SQUARE) {
+        for (int j = 0, count = colliders.getCount(OBSTACLE_SQUARE); j < count; ++j) {
+            sweepSquare(colliders.squares, j, segment, hit);
+        }
+    }
+    if (TYPES & OBSTACLE_MASK_TRIANGLE) {
+        for (int j = 0, count = colliders.getCount(OBSTACLE_TRIANGLE); j < count; ++j) {
+            sweepTriangle(colliders.triangles, j, segment, hit);
+        }
+    }
+    if (TYPES & OBSTACLE_MASK_CIRCLE) {
+        for (int j = 0, count = colliders.getCount(OBSTACLE_CIRCLE); j < count; ++j) {
+            sweepCircle(colliders.circles, j, segment, hit);
+        }
+    }
+    if (TYPES & OBSTACLE_MASK_POLYGON) {
+        for (int j = 0, count = colliders.getCount(OBSTACLE_POLYGON); j < count; ++j) {
+            sweepPolygon(colliders.polygons, j, segment, hit);
+        }
+    }
+}
+
+// Obstacles near a run of particles, as (type, index) pairs.
+struct NearObstacles {
+    int type[NEAR_OBSTACLES], index[NEAR_OBSTACLES];
+    int count;
+};
+
+template <unsigned TYPES>
+static void sweepObstacle(const ObstacleColliders& colliders, int type, int j, const Segment& segment, Hit& hit) {
+    if ((TYPES & OBSTACLE_MASK_SQUARE) && type == OBSTACLE_SQUARE) {
+        sweepSquare(colliders.squares, j, segment, hit);
+    }
+    else if ((TYPES & OBSTACLE_MASK_TRIANGLE) && type == OBSTACLE_TRIANGLE) {
+        sweepTriangle(colliders.triangles, j, segment, hit);
+    }
+    else if ((TYPES & OBSTACLE_MASK_CIRCLE) && type == OBSTACLE_CIRCLE) {
+        sweepCircle(colliders.circles, j, segment, hit);
+    }
+    else if ((TYPES & OBSTACLE_MASK_POLYGON) && type == OBSTACLE_POLYGON) {
+        sweepPolygon(colliders.polygons, j, segment, hit);
+    }
+}
+
+template <unsigned TYPES>
+static void sweepTree(const ObstacleColliders& colliders, const ObstacleTree& tree, const Segment& segment, Hit& hit) {
+    tree.query(segment.min, segment.max, [&](int type, int j) {
+        sweepObstacle<TYPES>(colliders, type, j, segment, hit);
+    });
+}
+
+template <unsigned TYPES>
+static void sweepNear(const ObstacleColliders& colliders, const NearObstacles& nearby, const Segment& segment, Hit& hit) {
+    for (int k = 0; k < nearby.count; ++k) {
+        sweepObstacle<TYPES>(colliders, nearby.type[k], nearby.index[k], segment, hit);
+    }
+}
+
+// Sweeps particle i until it stops hitting anything and writes back its
+// position and velocity if it bounced. sweep(segment, hit) tests the
+// obstacles the segment may touch.
+template <typename Sweep>
+static void resolveParticle(const ParticleColumns& p, int i, Sweep&& sweep) {
+    glm::vec2 start(p.prevX[i], p.prevY[i]);
+    glm::vec2 delta = glm::vec2(p.x[i], p.y[i]) - start;
+    glm::vec2 velocity(p.vx[i], p.vy[i]);
+    bool bounced = false;
+
+    for (int bounce = 0; bounce <= MAX_BOUNCES; ++bounce) {
+        Segment segment(start, delta);
+        Hit hit = { 1.0f, glm::vec2(0.0f) };
+        sweep(segment, hit);
+        if (hit.t >= 1.0f) break;
+
+        bounced = true;
+        start += delta * hit.t + hit.normal * SURFACE_OFFSET;
+        if (bounce == MAX_BOUNCES) {
+            delta = glm::vec2(0.0f);
+            break;
+        }
+        glm::vec2 remaining = delta * (1.0f - hit.t);
+        delta = remaining - 2.0f * glm::dot(remaining, hit.normal) * hit.normal;
+        // A particle sliding along an edge can hit it while already
+        // moving away; leave its velocity alone then.
+        float approach = glm::dot(velocity, hit.normal);
+        if (approach < 0.0f) velocity -= 2.0f * approach * hit.normal;
+    }
+
+    if (!bounced) return;
+    p.x[i] = start.x + delta.x;
+    p.y[i] = start.y + delta.y;
+    p.vx[i] = velocity.x;
+    p.vy[i] = velocity.y;
+}
+
+// Flags the particles of a block whose step bounds overlap the box
+// [minX, maxX] x [minY, maxY]. Vectorizes over the block.
+static void markOverlaps(const float* PARTICLE_RESTRICT segMinX, const float* PARTICLE_RESTRICT segMinY,
+    const float* PARTICLE_RESTRICT segMaxX, const float* PARTICLE_RESTRICT segMaxY, int count,
+    float minX, float minY, float maxX, float maxY, int* PARTICLE_RESTRICT candidate) {
+    for (int i = 0; i < count; ++i) {
+        candidate[i] |= (segMinX[i] <= maxX) & (segMaxX[i] >= minX) & (segMinY[i] <= maxY) & (segMaxY[i] >= minY);
+    }
+}
+
+// Bounds of each particle's step, with candidate cleared. Dead particles get
+// empty bounds, so they neither widen a run nor overlap anything.
+static void getStepBounds(const ParticleColumns& p, float* PARTICLE_RESTRICT segMinX, float* PARTICLE_RESTRICT segMinY,
+    float* PARTICLE_RESTRICT segMaxX, float* PARTICLE_RESTRICT segMaxY, int* PARTICLE_RESTRICT candidate) {
+    const float* PARTICLE_RESTRICT x = p.x;
+    const float* PARTICLE_RESTRICT y = p.y;
+    const float* PARTICLE_RESTRICT prevX = p.prevX;
+    const float* PARTICLE_RESTRICT prevY = p.prevY;
+    const float* PARTICLE_RESTRICT lifetime = p.lifetime;
+    for (int i = 0, count = p.count; i < count; ++i) {
+        float minX = x[i] < prevX[i] ? x[i] : prevX[i];
+        float maxX = x[i] < prevX[i] ? prevX[i] : x[i];
+        float minY = y[i] < prevY[i] ? y[i] : prevY[i];
+        float maxY = y[i] < prevY[i] ? prevY[i] : y[i];
+        bool alive = lifetime[i] > 0.0f;
+        segMinX[i] = alive ? minX : FLT_MAX;
+        segMaxX[i] = alive ? maxX : -FLT_MAX;
+        segMinY[i] = alive ? minY : FLT_MAX;
+        segMaxY[i] = alive ? maxY : -FLT_MAX;
+        candidate[i] = 0;
+    }
+}
+
+// Bounds of a run of step bounds and the longest step in it, as width plus
+// height. count is a multiple of PARTICLE_SIMD_WIDTH; each lane keeps its
+// own extremes so the loop vectorizes without a min/max reduction.
+static void getRunBounds(const float* PARTICLE_RESTRICT segMinX, const float* PARTICLE_RESTRICT segMinY,
+    const float* PARTICLE_RESTRICT segMaxX, const float* PARTICLE_RESTRICT segMaxY, int count,
+    float& minX, float& minY, float& maxX, float& maxY, float& reach) {
+    float lowX[PARTICLE_SIMD_WIDTH], lowY[PARTICLE_SIMD_WIDTH], highX[PARTICLE_SIMD_WIDTH], highY[PARTICLE_SIMD_WIDTH];
+    float longest[PARTICLE_SIMD_WIDTH];
+    for (int l = 0; l < PARTICLE_SIMD_WIDTH; ++l) {
+        lowX[l] = FLT_MAX;
+        lowY[l] = FLT_MAX;
+        highX[l] = -FLT_MAX;
+        highY[l] = -FLT_MAX;
+        longest[l] = 0.0f;
+    }
+    for (int i = 0; i < count; i += PARTICLE_SIMD_WIDTH) {
+        for (int l = 0; l < PARTICLE_SIMD_WIDTH; ++l) {
+            float x0 = segMinX[i + l], y0 = segMinY[i + l], x1 = segMaxX[i + l], y1 = segMaxY[i + l];
+            lowX[l] = x0 < lowX[l] ? x0 : lowX[l];
+            lowY[l] = y0 < lowY[l] ? y0 : lowY[l];
+            highX[l] = x1 > highX[l] ? x1 : highX[l];
+            highY[l] = y1 > highY[l] ? y1 : highY[l];
+            float extent = (x1 - x0) + (y1 - y0);
+            longest[l] = extent > longest[l] ? extent : longest[l];
+        }
+    }
+    minX = lowX[0];
+    minY = lowY[0];
+    maxX = highX[0];
+    maxY = highY[0];
+    reach = longest[0];
+    for (int l = 1; l < PARTICLE_SIMD_WIDTH; ++l) {
+        minX = lowX[l] < minX ? lowX[l] : minX;
+        minY = lowY[l] < minY ? lowY[l] : minY;
+        maxX = highX[l] > maxX ? highX[l] : maxX;
+        maxY = highY[l] > maxY ? highY[l] : maxY;
+        reach = longest[l] > reach ? longest[l] : reach;
+    }
+}
+
+unsigned getObstacleTypeMask(const ObstacleColliders& colliders) {
+    unsigned types = 0;
+    if (colliders.getCount(OBSTACLE_SQUARE) > 0) types |= OBSTACLE_MASK_SQUARE;
+    if (colliders.getCount(OBSTACLE_TRIANGLE) > 0) types |= OBSTACLE_MASK_TRIANGLE;
+    if (colliders.getCount(OBSTACLE_CIRCLE) > 0) types |= OBSTACLE_MASK_CIRCLE;
+    if (colliders.getCount(OBSTACLE_POLYGON) > 0) types |= OBSTACLE_MASK_POLYGON;
+    return types;
+}
+
+// Flags the particles of a block whose step bounds overlap obstacle j of
+// type.
+static void markObstacle(const ObstacleColliders& colliders, int type, int j,
+    const float* segMinX, const float* segMinY, const float* segMaxX, const float* segMaxY, int count, int* candidate) {
+    if (type == OBSTACLE_SQUARE) {
+        const SquareColliders& squares = colliders.squares;
+        markOverlaps(segMinX, segMinY, segMaxX, segMaxY, count,
+            squares.minX[j], squares.minY[j], squares.maxX[j], squares.maxY[j], candidate);
+    }
+    else if (type == OBSTACLE_TRIANGLE) {
+        const TriangleColliders& triangles = colliders.triangles;
+        markOverlaps(segMinX, segMinY, segMaxX, segMaxY, count,
+            triangles.minX[j], triangles.minY[j], triangles.maxX[j], triangles.maxY[j], candidate);
+    }
+    else if (type == OBSTACLE_CIRCLE) {
+        const CircleColliders& circles = colliders.circles;
+        float cx = circles.x[j], cy = circles.y[j], radius = circles.radius[j];
+        markOverlaps(segMinX, segMinY, segMaxX, segMaxY, count,
+            cx - radius, cy - radius, cx + radius, cy + radius, candidate);
+    }
+    else {
+        const PolygonColliders& polygons = colliders.polygons;
+        markOverlaps(segMinX, segMinY, segMaxX, segMaxY, count,
+            polygons.minX[j], polygons.minY[j], polygons.maxX[j], polygons.maxY[j], candidate);
+    }
+}
+
+// Step bounds of one block of particles, empty for dead ones.
+struct BlockBounds {
+    alignas(PARTICLE_ALIGNMENT) float minX[COLLISION_BLOCK];
+    alignas(PARTICLE_ALIGNMENT) float minY[COLLISION_BLOCK];
+    alignas(PARTICLE_ALIGNMENT) float maxX[COLLISION_BLOCK];
+    alignas(PARTICLE_ALIGNMENT) float maxY[COLLISION_BLOCK];
+    alignas(PARTICLE_ALIGNMENT) int candidate[COLLISION_BLOCK];
+};
+
+// Resolves entries [first, last) of the block starting at particle base
+// against the obstacles the tree finds near them; first and last are
+// multiples of PARTICLE_SIMD_WIDTH. Their bounds are grown by the longest
+// step among them, which also holds every bounce, so flagged particles
+// only sweep that list. A run with too many obstacles near it is halved
+// while that may tighten its bounds; below MIN_NEAR_RUN particles each
+// walks the tree instead.
+template <unsigned TYPES>
+static void collideRun(const ParticleColumns& p, int base, int first, int last, BlockBounds& b,
+    const ObstacleColliders& colliders, const ObstacleTree& tree) {
+    float runMinX, runMinY, runMaxX, runMaxY, reach;
+    getRunBounds(b.minX + first, b.minY + first, b.maxX + first, b.maxY + first, last - first,
+        runMinX, runMinY, runMaxX, runMaxY, reach);
+    if (runMinX > runMaxX) return;
+    reach += 1.0f;
+
+    NearObstacles nearby;
+    nearby.count = 0;
+    tree.query(glm::vec2(runMinX, runMinY) - glm::vec2(reach), glm::vec2(runMaxX, runMaxY) + glm::vec2(reach), [&](int type, int j) {
+        if (nearby.count < NEAR_OBSTACLES) {
+            nearby.type[nearby.count] = type;
+            nearby.index[nearby.count] = j;
+        }
+        nearby.count++;
+    });
+    if (nearby.count > NEAR_OBSTACLES) {
+        if (last - first > MIN_NEAR_RUN) {
+            int middle = first + ((last - first) / 2 & ~(PARTICLE_SIMD_WIDTH - 1));
+            collideRun<TYPES>(p, base, first, middle, b, colliders, tree);
+            collideRun<TYPES>(p, base, middle, last, b, colliders, tree);
+            return;
+        }
+        for (int i = first; i < last; ++i) {
+            if (p.lifetime[base + i] <= 0.0f) continue;
+            resolveParticle(p, base + i, [&](const Segment& segment, Hit& hit) {
+                sweepTree<TYPES>(colliders, tree, segment, hit);
+            });
+        }
+        return;
+    }
+
+    for (int k = 0; k < nearby.count; ++k) {
+        markObstacle(colliders, nearby.type[k], nearby.index[k], b.minX + first, b.minY + first, b.maxX + first, b.maxY + first,
+            last - first, b.candidate + first);
+    }
+    for (int i = first; i < last; ++i) {
+        if (!b.candidate[i]) continue;
+        resolveParticle(p, base + i, [&](const Segment& segment, Hit& hit) {
+            sweepNear<TYPES>(colliders, nearby, segment, hit);
+        });
+    }
+}
+
+template <unsigned TYPES>
+void collideObstacleTypes(const ParticleColumns& p, const ObstacleColliders& colliders, const ObstacleTree* tree) {
+    if (TYPES == 0 || colliders.getTotalCount() == 0) return;
+
+    // A vectorized bounds pass over each block finds the few particles whose
+    // step comes near any obstacle; only those are swept. Without a tree
+    // every obstacle is checked against the whole block.
+    BlockBounds b;
+    for (int begin = 0; begin < p.count; begin += COLLISION_BLOCK) {
+        int count = begin + COLLISION_BLOCK < p.count ? COLLISION_BLOCK : p.count - begin;
+        getStepBounds(p.slice(begin, begin + count), b.minX, b.minY, b.maxX, b.maxY, b.candidate);
+
+        if (tree) {
+            collideRun<TYPES>(p, begin, 0, count, b, colliders, *tree);
+            continue;
+        }
+        for (int type = 0; type < OBSTACLE_TYPE_COUNT; ++type) {
+            if (!(TYPES & (1u << type))) continue;
+            for (int j = 0, n = colliders.getCount(type); j < n; ++j) {
+                markObstacle(colliders, type, j, b.minX, b.minY, b.maxX, b.maxY, count, b.candidate);
+            }
+        }
+        for (int i = 0; i < count; ++i) {
+            if (!b.candidate[i]) continue;
+            resolveParticle(p, begin + i, [&](const Segment& segment, Hit& hit) {
+                sweepAll<TYPES>(colliders, segment, hit);
+            });
+        }
+    }
+}
+
+template void collideObstacleTypes<0>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<1>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<2>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<3>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<4>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<5>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<6>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<7>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<8>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<9>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<10>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<11>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<12>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<13>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<14>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+template void collideObstacleTypes<15>(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+
+typedef void (*CollideObstaclesFunction)(const ParticleColumns&, const ObstacleColliders&, const ObstacleTree*);
+
+static const CollideObstaclesFunction COLLIDE_OBSTACLES[OBSTACLE_MASK_ALL + 1] = {
+    collideObstacleTypes<0>, collideObstacleTypes<1>, collideObstacleTypes<2>, collideObstacleTypes<3>,
+    collideObstacleTypes<4>, collideObstacleTypes<5>, collideObstacleTypes<6>, collideObstacleTypes<7>,
+    collideObstacleTypes<8>, collideObstacleTypes<9>, collideObstacleTypes<10>, collideObstacleTypes<11>,
+    collideObstacleTypes<12>, collideObstacleTypes<13>, collideObstacleTypes<14>, collideObstacleTypes<15>,
+};
+
+void collideObstacles(const ParticleColumns& p, const ObstacleColliders& colliders, const ObstacleTree* tree) {
+    COLLIDE_OBSTACLES[getObstacleTypeMask(colliders)](p, colliders, tree);
+}
@@ -0,0 +1,39 @@
+#ifndef COLLISION_KERNELS_H
+#define COLLISION_KERNELS_H
+
+#include "obstacle_colliders.h"
+#include "obstacle_tree.h"
+#include "particle_pool.h"
+
+// Swept collision of the step every live particle just took, from
+// (prevX, prevY) to (x, y). The earliest obstacle the segment enters stops
+// it at the time of impact; velocity and the rest of the step are reflected
+// about the surface normal there and the sweep continues from the impact
+// point, up to a few bounces per step. A particle that starts the step
+// inside an obstacle is let out rather than bounced.
+//
+// Particles are culled in blocks: the tree yields the obstacles near a
+// block's steps and only particles whose step bounds overlap one of those
+// are swept, against that short list. With nullptr the block is checked
+// against every collider instead.
+void collideObstacles(const ParticleColumns& p, const ObstacleColliders& colliders, const ObstacleTree* tree);
+
+// Obstacle types as bits, 1 << ObstacleType.
+enum ObstacleTypeMask {
+    OBSTACLE_MASK_SQUARE = 1 << OBSTACLE_SQUARE,
+    OBSTACLE_MASK_TRIANGLE = 1 << OBSTACLE_TRIANGLE,
+    OBSTACLE_MASK_CIRCLE = 1 << OBSTACLE_CIRCLE,
+    OBSTACLE_MASK_POLYGON = 1 << OBSTACLE_POLYGON,
+    OBSTACLE_MASK_ALL = OBSTACLE_MASK_SQUARE | OBSTACLE_MASK_TRIANGLE | OBSTACLE_MASK_CIRCLE | OBSTACLE_MASK_POLYGON
+};
+
+// The types colliders has at least one obstacle of.
+unsigned getObstacleTypeMask(const ObstacleColliders& colliders);
+
+// collideObstacles for the obstacle types in the mask TYPES only; the code
+// for the others is compiled out. Instantiated for every mask up to
+// OBSTACLE_MASK_ALL.
+template <unsigned TYPES>
+void collideObstacleTypes(const ParticleColumns& p, const ObstacleColliders& colliders, const ObstacleTree* tree);
+
+#endif // !COLLISION_KERNELS_H
@@ -0,0 +1,42 @@
+#include "color_gradient.h"
+
+ColorGradient::ColorGradient(glm::vec4 color) {
+    setConstant(color);
+}
+
+void ColorGradient::setConstant(glm::vec4 color) {
+    positions[0] = 0.0f;
+    colors[0] = color;
+    count = 1;
+}
+
+bool ColorGradient::addStop(float position, glm::vec4 color) {
+    if (count == MAX_STOPS) return false;
+    int i = count++;
+    for (; i > 0 && positions[i - 1] > position; --i) {
+        positions[i] = positions[i - 1];
+        colors[i] = colors[i - 1];
+    }
+    positions[i] = position;
+    colors[i] = color;
+    return true;
+}
+
+void ColorGradient::setStops(const float* stopPositions, const glm::vec4* stopColors, int stopCount) {
+    for (int i = 0; i < stopCount; ++i) {
+        positions[i] = stopPositions[i];
+        colors[i] = stopColors[i];
+    }
+    count = stopCount;
+}
+
+glm::vec4 ColorGradient::evaluate(float age) const {
+    if (age <= positions[0]) return colors[0];
+    for (int i = 1; i < count; ++i) {
+        if (age < positions[i]) {
+            float t = (age - positions[i - 1]) / (positions[i] - positions[i - 1]);
+            return glm::mix(colors[i - 1], colors[i], t);
+        }
+    }
+    return colors[count - 1];
+}
@@ -0,0 +1,38 @@
+#ifndef COLOR_GRADIENT_H
+#define COLOR_GRADIENT_H
+
+#include <glm/glm.hpp>
+
+// Piecewise-linear color over a particle's life, sampled by age from 0 at
+// spawn to 1 at the end of its lifetime. Before the first stop and after
+// the last one the color is held. The stop count is capped so the viewer
+// can pass the stops as fixed-size shader uniforms and evaluate the
+// gradient per vertex; evaluate() is the same function on the CPU.
+class ColorGradient {
+public:
+    static const int MAX_STOPS = 8;
+
+    explicit ColorGradient(glm::vec4 color = glm::vec4(1.0f));
+
+    // A single stop, so the whole life has one color.
+    void setConstant(glm::vec4 color);
+    // Inserts a stop keeping the stops sorted by position; returns false
+    // once MAX_STOPS are used.
+    bool addStop(float position, glm::vec4 color);
+    // Replaces every stop; positions must be sorted and count within
+    // [1, MAX_STOPS].
+    void setStops(const float* stopPositions, const glm::vec4* stopColors, int stopCount);
+
+    glm::vec4 evaluate(float age) const;
+
+    int getStopCount() const { return count; }
+    const float* getPositions() const { return positions; }
+    const glm::vec4* getColors() const { return colors; }
+
+private:
+    float positions[MAX_STOPS];
+    glm::vec4 colors[MAX_STOPS];
+    int count;
+};
+
+#endif // !COLOR_GRADIENT_H
@@ -0,0 +1,115 @@
+#include "emitter.h"
+#include <algorithm>
+#include <cmath>
+#include <glm/gtc/packing.hpp>
+
+// Spawned particles per fill job.
+static const int SPAWN_CHUNK_SIZE = 4096;
+
+// Random draws per spawned particle: vx, vy, lifetime and, with a
+// palette, the palette entry.
+static int spawnDraws(const Emitter& emitter) {
+    return emitter.palette.empty() ? 3 : 4;
+}
+
+// Fills particles [offset, offset + count) of this step's spawn from one
+// emitter into p, which starts at the first of them and must not cross a
+// page. The emitter's draws for the step are laid out column by column
+// from streamBase, total particles per column, so any sub-range can be
+// filled independently.
+static void fillSpawned(const Emitter& emitter, const ParticleColumns& p, int offset, int count, int total, uint64_t streamBase) {
+    RandomStream random = emitter.random;
+    random.seek(streamBase + offset);
+    random.fillUniform(p.vx, count, emitter.velocityMin.x, emitter.velocityMax.x);
+    random.seek(streamBase + total + offset);
+    random.fillUniform(p.vy, count, emitter.velocityMin.y, emitter.velocityMax.y);
+    random.seek(streamBase + 2 * static_cast<uint64_t>(total) + offset);
+    random.fillUniform(p.lifetime, count, emitter.lifetimeMin, emitter.lifetimeMax);
+
+    for (int i = 0; i < count; ++i) {
+        p.x[i] = emitter.position.x;
+        p.y[i] = emitter.position.y;
+        p.prevX[i] = emitter.position.x;
+        p.prevY[i] = emitter.position.y;
+    }
+
+    if (emitter.palette.empty()) {
+        uint32_t color = glm::packUnorm4x8(emitter.color);
+        for (int i = 0; i < count; ++i) p.color[i] = color;
+    }
+    else {
+        int entries = static_cast<int>(emitter.palette.size());
+        random.seek(streamBase + 3 * static_cast<uint64_t>(total) + offset);
+        for (int i = 0; i < count; ++i) {
+            int entry = std::min(static_cast<int>(random.nextFloat() * entries), entries - 1);
+            p.color[i] = glm::packUnorm4x8(emitter.palette[entry]);
+        }
+    }
+}
+
+int emitParticles(std::vector<Emitter>& emitters, ParticlePool& pool, float deltaTime, JobSystem* jobs) {
+    std::vector<int> owed(emitters.size());
+    int requested = 0;
+    for (size_t e = 0; e < emitters.size(); ++e) {
+        Emitter& emitter = emitters[e];
+        int count = emitter.burstCount;
+        emitter.burstCount = 0;
+        if (emitter.enabled && emitter.rate > 0.0f) {
+            emitter.accumulator += emitter.rate * deltaTime;
+            float whole = std::floor(emitter.accumulator);
+            emitter.accumulator -= whole;
+            count += static_cast<int>(whole);
+        }
+        else {
+            emitter.accumulator = 0.0f;
+        }
+        owed[e] = count;
+        requested += count;
+    }
+    if (requested == 0) return 0;
+
+    int first = pool.getLiveCount();
+    int remaining = pool.allocate(requested);
+    int spawned = remaining;
+
+    // Trim what each emitter gets to the granted total, note where its
+    // particles start and where its draws start, then advance its stream
+    // past them.
+    std::vector<int> granted(emitters.size()), start(emitters.size() + 1);
+    std::vector<uint64_t> streamBase(emitters.size());
+    start[0] = 0;
+    for (size_t e = 0; e < emitters.size(); ++e) {
+        granted[e] = std::min(owed[e], remaining);
+        remaining -= granted[e];
+        start[e + 1] = start[e] + granted[e];
+        streamBase[e] = emitters[e].random.tell();
+        emitters[e].random.seek(streamBase[e] + static_cast<uint64_t>(spawnDraws(emitters[e])) * granted[e]);
+    }
+
+    // Runs are cut wherever the emitter changes or a page ends.
+    auto fill = [&](int begin, int end, int) {
+        size_t e = std::upper_bound(start.begin(), start.end(), begin) - start.begin() - 1;
+        while (begin < end) {
+            if (begin == start[e + 1]) {
+                e++;
+                continue;
+            }
+            int slot = first + begin;
+            int entry = slot & (PARTICLE_PAGE_SIZE - 1);
+            int count = std::min(std::min(end, start[e + 1]) - begin, PARTICLE_PAGE_SIZE - entry);
+            ParticleColumns page = pool.getPage(slot >> PARTICLE_PAGE_SHIFT).slice(entry, entry + count);
+            fillSpawned(emitters[e], page, begin - start[e], count, granted[e], streamBase[e]);
+            begin += count;
+        }
+    };
+    if (jobs) {
+        jobs->parallelFor(spawned, SPAWN_CHUNK_SIZE, fill);
+    }
+    else {
+        fill(0, spawned, 0);
+    }
+
+    // A zero lifetime roll is dead on arrival; keep the live range packed.
+    pool.compact(first);
+    return spawned;
+}
@@ -0,0 +1,52 @@
+#ifndef EMITTER_H
+#define EMITTER_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "job_system.h"
+#include "particle_pool.h"
+#include "random_stream.h"
+
+// Point source of particles. rate is continuous emission in particles per
+// second; the fractional remainder carries over in accumulator so the
+// output does not depend on the step length. burstCount is emitted once on
+// the next pass and then reset, even while the emitter is disabled.
+struct Emitter {
+    glm::vec2 position = glm::vec2(0.0f);
+    float rate = 60.0f;
+    int burstCount = 0;
+    bool enabled = true;
+
+    // Each velocity component and the lifetime are drawn uniformly from
+    // [min, max].
+    glm::vec2 velocityMin = glm::vec2(-50.0f);
+    glm::vec2 velocityMax = glm::vec2(50.0f);
+    float lifetimeMin = 0.0f;
+    float lifetimeMax = 5.0f;
+    glm::vec4 color = glm::vec4(1.0f);
+    // When not empty, each particle instead gets a uniformly drawn entry.
+    std::vector<glm::vec4> palette;
+
+    float accumulator = 0.0f;
+    // ParticleSystem::addEmitter gives each emitter its own stream.
+    RandomStream random;
+
+    // The spread the viewer has always used: velocity in +-velocity/2 on
+    // each axis, lifetime in [0, lifetime].
+    void setSpread(float velocity, float lifetime) {
+        velocityMin = glm::vec2(-velocity / 2);
+        velocityMax = glm::vec2(velocity / 2);
+        lifetimeMin = 0.0f;
+        lifetimeMax = lifetime;
+    }
+};
+
+// Runs every emitter for one step: works out how many particles each one
+// owes, claims all of them from the pool in one allocation and fills the
+// slots. When the pool runs out, earlier emitters win. The fill is spread
+// over jobs when given one; every particle's draws are at a fixed position
+// in its emitter's stream, so the result does not depend on the threads.
+// Returns the number of particles spawned.
+int emitParticles(std::vector<Emitter>& emitters, ParticlePool& pool, float deltaTime, JobSystem* jobs = nullptr);
+
+#endif // !EMITTER_H
@@ -0,0 +1,31 @@
+#include "fixed_timestep.h"
+#include <algorithm>
+
+FixedTimestep::FixedTimestep(float rate, int maxSteps) : rate(1.0f), step(1.0f), maxSteps(1), accumulator(0.0f) {
+    setRate(rate);
+    setMaxSteps(maxSteps);
+}
+
+int FixedTimestep::advance(float frameTime) {
+    accumulator += std::max(frameTime, 0.0f);
+    int steps = static_cast<int>(accumulator / step);
+    if (steps > maxSteps) {
+        steps = maxSteps;
+        accumulator = 0.0f;
+    }
+    else {
+        accumulator -= steps * step;
+    }
+    accumulator = std::min(std::max(accumulator, 0.0f), step);
+    return steps;
+}
+
+void FixedTimestep::setRate(float newRate) {
+    rate = std::max(newRate, 1.0f);
+    step = 1.0f / rate;
+    accumulator = std::min(accumulator, step);
+}
+
+void FixedTimestep::setMaxSteps(int newMaxSteps) {
+    maxSteps = std::max(newMaxSteps, 1);
+}
@@ -0,0 +1,30 @@
+#ifndef FIXED_TIMESTEP_H
+#define FIXED_TIMESTEP_H
+
+// Turns variable frame times into a whole number of fixed simulation steps.
+// Leftover time carries over to the next frame; getAlpha() says how far
+// the current frame is between the last two simulated states. After a hitch
+// at most maxSteps are run and the rest of the backlog is dropped, so a
+// slow frame cannot snowball into ever longer ones.
+class FixedTimestep {
+public:
+    FixedTimestep(float rate = 60.0f, int maxSteps = 4);
+
+    // Returns how many steps of getStep() seconds to run for this frame.
+    int advance(float frameTime);
+
+    void setRate(float rate);
+    void setMaxSteps(int maxSteps);
+    float getRate() const { return rate; }
+    int getMaxSteps() const { return maxSteps; }
+    float getStep() const { return step; }
+    float getAlpha() const { return accumulator / step; }
+
+private:
+    float rate;
+    float step;
+    int maxSteps;
+    float accumulator;
+};
+
+#endif // !FIXED_TIMESTEP_H
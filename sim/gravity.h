@@ -0,0 +1,29 @@
+#ifndef GRAVITY_H
+#define GRAVITY_H
+
+enum GravitySolver {
+    // Quadtree, O(N log N); accurate down to the softening length.
+    GRAVITY_BARNES_HUT = 0,
+    // Mass on a mesh, O(N + G^2 log G); resolves nothing finer than a cell.
+    GRAVITY_PARTICLE_MESH = 1
+};
+
+// Particle-particle attraction. Every live particle is a body of unit mass.
+struct GravitySettings {
+    bool enabled = false;
+    int solver = GRAVITY_BARNES_HUT;
+    // Positive pulls bodies together like gravity; negative pushes them
+    // apart like equal charges. In px^3/s^2 per unit mass.
+    float strength = 1000.0f;
+    // Plummer softening length in pixels; keeps close encounters finite and
+    // makes a body's pull on itself zero.
+    float softening = 4.0f;
+    // Barnes-Hut opening angle: a cell of width w whose center of mass is d
+    // away is treated as a single body when w < theta * d. 0 makes every
+    // lookup exact.
+    float theta = 0.5f;
+    // Particle-mesh nodes per side; a power of two.
+    int meshSize = 256;
+};
+
+#endif // !GRAVITY_H
@@ -0,0 +1,111 @@
+#include "job_system.h"
+#include <algorithm>
+
+static thread_local const JobSystem* currentSystem = nullptr;
+static thread_local int currentIndex = 0;
+
+JobSystem::JobSystem(int threadCount) : queued(0), stopping(false) {
+    if (threadCount <= 0) {
+        threadCount = std::max(1, static_cast<int>(std::thread::hardware_concurrency()));
+    }
+    for (int i = 0; i < threadCount; ++i) {
+        queues.push_back(std::make_unique<Queue>());
+    }
+    // Slot 0 belongs to whichever outside thread calls parallelFor.
+    for (int i = 1; i < threadCount; ++i) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+    }
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    wake.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+void JobSystem::parallelFor(int count, int chunkSize, const std::function<void(int, int, int)>& body) {
+    if (count <= 0) return;
+    chunkSize = std::max(chunkSize, 1);
+    int chunks = (count + chunkSize - 1) / chunkSize;
+    int thread = currentThread();
+
+    if (chunks == 1 || queues.size() == 1) {
+        for (int begin = 0; begin < count; begin += chunkSize) {
+            body(begin, std::min(begin + chunkSize, count), thread);
+        }
+        return;
+    }
+
+    // Deal the chunks out round-robin, starting with our own queue, so every
+    // thread has local work before anyone needs to steal.
+    std::atomic<int> pending(chunks);
+    int threads = getThreadCount();
+    for (int c = 0; c < chunks; ++c) {
+        int begin = c * chunkSize;
+        Queue& queue = *queues[(thread + c) % threads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.jobs.push_back({ &body, begin, std::min(begin + chunkSize, count), &pending });
+    }
+    queued.fetch_add(chunks);
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+    }
+    wake.notify_all();
+
+    while (pending.load(std::memory_order_acquire) > 0) {
+        if (!runOne(thread)) std::this_thread::yield();
+    }
+}
+
+bool JobSystem::popLocal(int thread, Job& job) {
+    Queue& queue = *queues[thread];
+    std::lock_guard<std::mutex> lock(queue.mutex);
+    if (queue.jobs.empty()) return false;
+    job = queue.jobs.back();
+    queue.jobs.pop_back();
+    return true;
+}
+
+bool JobSystem::steal(int thread, Job& job) {
+    int threads = getThreadCount();
+    for (int offset = 1; offset < threads; ++offset) {
+        Queue& queue = *queues[(thread + offset) % threads];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        if (queue.jobs.empty()) continue;
+        job = queue.jobs.front();
+        queue.jobs.pop_front();
+        return true;
+    }
+    return false;
+}
+
+bool JobSystem::runOne(int thread) {
+    Job job;
+    if (!popLocal(thread, job) && !steal(thread, job)) return false;
+    queued.fetch_sub(1);
+    (*job.body)(job.begin, job.end, thread);
+    job.pending->fetch_sub(1, std::memory_order_release);
+    return true;
+}
+
+void JobSystem::workerLoop(int thread) {
+    currentSystem = this;
+    currentIndex = thread;
+
+    while (true) {
+        if (runOne(thread)) continue;
+
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        wake.wait(lock, [this] { return stopping || queued.load() > 0; });
+        if (stopping && queued.load() == 0) return;
+    }
+}
+
+int JobSystem::currentThread() const {
+    return currentSystem == this ? currentIndex : 0;
+}
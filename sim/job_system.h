@@ -0,0 +1,63 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed pool of worker threads with one job deque per thread. A thread
+// pops its own newest job first and, once its deque is empty, steals the
+// oldest job from someone else's. The thread calling parallelFor takes
+// part in the work instead of just waiting for it.
+class JobSystem {
+public:
+    // threadCount counts the calling thread; 0 picks one per hardware thread.
+    // Threads outside the pool share slot 0, so only one of them should
+    // call parallelFor at a time.
+    explicit JobSystem(int threadCount = 0);
+    ~JobSystem();
+    JobSystem(const JobSystem&) = delete;
+    JobSystem& operator=(const JobSystem&) = delete;
+
+    int getThreadCount() const { return static_cast<int>(queues.size()); }
+
+    // Calls body(begin, end, thread) for consecutive chunks of at most
+    // chunkSize covering [0, count) and returns once all of them ran.
+    // thread is in [0, getThreadCount()) and is stable for the duration of
+    // a chunk, so it can index per-thread scratch. Chunk boundaries depend
+    // only on count and chunkSize, never on the thread count. May be called
+    // from inside a job.
+    void parallelFor(int count, int chunkSize, const std::function<void(int, int, int)>& body);
+
+private:
+    struct Job {
+        const std::function<void(int, int, int)>* body;
+        int begin, end;
+        std::atomic<int>* pending;
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Job> jobs;
+    };
+
+    bool popLocal(int thread, Job& job);
+    bool steal(int thread, Job& job);
+    bool runOne(int thread);
+    void workerLoop(int thread);
+    int currentThread() const;
+
+    std::vector<std::unique_ptr<Queue>> queues;
+    std::vector<std::thread> workers;
+    std::mutex sleepMutex;
+    std::condition_variable wake;
+    std::atomic<int> queued;
+    bool stopping;
+};
+
+#endif // !JOB_SYSTEM_H
@@ -0,0 +1,128 @@
+#include "morton_order.h"
+#include <glm/glm.hpp>
+#include <algorithm>
+#include <numeric>
+
+static const int RADIX_BITS = 8;
+static const int RADIX = 1 << RADIX_BITS;
+
+// Keys per histogram in the radix sort; fixed so the chunking, and with it
+// the result, does not follow the thread count.
+static const int SORT_CHUNK_SIZE = 1 << 16;
+
+// Cells per axis the keys can tell apart.
+static const uint32_t MAX_CELL = 0xffffu;
+
+static void runParallel(JobSystem* jobs, int count, int chunkSize, const std::function<void(int, int, int)>& body) {
+    if (jobs) {
+        jobs->parallelFor(count, chunkSize, body);
+    }
+    else {
+        body(0, count, 0);
+    }
+}
+
+static uint32_t spreadBits(uint32_t v) {
+    v &= 0xffffu;
+    v = (v | (v << 8)) & 0x00ff00ffu;
+    v = (v | (v << 4)) & 0x0f0f0f0fu;
+    v = (v | (v << 2)) & 0x33333333u;
+    v = (v | (v << 1)) & 0x55555555u;
+    return v;
+}
+
+uint32_t encodeMorton(uint32_t column, uint32_t row) {
+    return (spreadBits(row) << 1) | spreadBits(column);
+}
+
+void radixSortByKey(std::vector<uint32_t>& keys, std::vector<int>& order, int keyBits, JobSystem* jobs) {
+    int count = static_cast<int>(keys.size());
+    order.resize(count);
+    std::iota(order.begin(), order.end(), 0);
+    if (count < 2) return;
+
+    int chunks = (count + SORT_CHUNK_SIZE - 1) / SORT_CHUNK_SIZE;
+    std::vector<uint32_t> keyScratch(count);
+    std::vector<int> orderScratch(count);
+    // offsets[chunk * RADIX + digit]: first the chunk's digit counts, then
+    // where its first key with that digit goes.
+    std::vector<int> offsets(static_cast<size_t>(chunks) * RADIX);
+    for (int shift = 0; shift < keyBits; shift += RADIX_BITS) {
+        runParallel(jobs, chunks, 1, [&](int begin, int end, int) {
+            for (int chunk = begin; chunk < end; ++chunk) {
+                int* histogram = &offsets[static_cast<size_t>(chunk) * RADIX];
+                std::fill(histogram, histogram + RADIX, 0);
+                int last = std::min(count, (chunk + 1) * SORT_CHUNK_SIZE);
+                for (int i = chunk * SORT_CHUNK_SIZE; i < last; ++i) {
+                    histogram[(keys[i] >> shift) & (RADIX - 1)]++;
+                }
+            }
+        });
+        int sum = 0;
+        for (int digit = 0; digit < RADIX; ++digit) {
+            for (int chunk = 0; chunk < chunks; ++chunk) {
+                int& offset = offsets[static_cast<size_t>(chunk) * RADIX + digit];
+                int digitCount = offset;
+                offset = sum;
+                sum += digitCount;
+            }
+        }
+        runParallel(jobs, chunks, 1, [&](int begin, int end, int) {
+            for (int chunk = begin; chunk < end; ++chunk) {
+                int* offset = &offsets[static_cast<size_t>(chunk) * RADIX];
+                int last = std::min(count, (chunk + 1) * SORT_CHUNK_SIZE);
+                for (int i = chunk * SORT_CHUNK_SIZE; i < last; ++i) {
+                    int target = offset[(keys[i] >> shift) & (RADIX - 1)]++;
+                    keyScratch[target] = keys[i];
+                    orderScratch[target] = order[i];
+                }
+            }
+        });
+        keys.swap(keyScratch);
+        order.swap(orderScratch);
+    }
+}
+
+void MortonSorter::sort(ParticlePool& pool, float cellSize, JobSystem* jobs) {
+    int count = pool.getLiveCount();
+    if (count < 2 || !(cellSize > 0.0f)) return;
+
+    glm::vec2 minBound(pool.getPage(0).x[0], pool.getPage(0).y[0]);
+    glm::vec2 maxBound = minBound;
+    for (int page = 0; page < pool.getLivePageCount(); ++page) {
+        ParticleColumns p = pool.getPage(page);
+        int live = std::min(count - page * PARTICLE_PAGE_SIZE, PARTICLE_PAGE_SIZE);
+        for (int i = 0; i < live; ++i) {
+            minBound = glm::min(minBound, glm::vec2(p.x[i], p.y[i]));
+            maxBound = glm::max(maxBound, glm::vec2(p.x[i], p.y[i]));
+        }
+    }
+
+    // Only as many key bits as the bounds need cells, so a screen's worth
+    // of particles sorts in three passes instead of four.
+    float inverseCellSize = 1.0f / cellSize;
+    float cellLimit = static_cast<float>(MAX_CELL);
+    glm::vec2 span = glm::min((maxBound - minBound) * inverseCellSize, glm::vec2(cellLimit));
+    uint32_t maxCell = static_cast<uint32_t>(std::max(span.x, span.y));
+    int bitsPerAxis = 1;
+    while (bitsPerAxis < 16 && (maxCell >> bitsPerAxis) != 0) bitsPerAxis++;
+
+    // NaN positions land in cell 0.
+    keys.resize(count);
+    runParallel(jobs, pool.getLivePageCount(), 1, [&](int begin, int end, int) {
+        for (int page = begin; page < end; ++page) {
+            ParticleColumns p = pool.getPage(page);
+            int offset = page * PARTICLE_PAGE_SIZE;
+            int live = std::min(count - offset, PARTICLE_PAGE_SIZE);
+            for (int i = 0; i < live; ++i) {
+                float u = (p.x[i] - minBound.x) * inverseCellSize;
+                float v = (p.y[i] - minBound.y) * inverseCellSize;
+                u = u > 0.0f ? (u < cellLimit ? u : cellLimit) : 0.0f;
+                v = v > 0.0f ? (v < cellLimit ? v : cellLimit) : 0.0f;
+                keys[offset + i] = encodeMorton(static_cast<uint32_t>(u), static_cast<uint32_t>(v));
+            }
+        }
+    });
+    radixSortByKey(keys, order, 2 * bitsPerAxis, jobs);
+    pool.reorder(order.data(), jobs);
+}
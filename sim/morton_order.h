@@ -0,0 +1,40 @@
+#ifndef MORTON_ORDER_H
+#define MORTON_ORDER_H
+
+#include <cstdint>
+#include <vector>
+#include "job_system.h"
+#include "particle_pool.h"
+
+struct ReorderSettings {
+    // Updates between sorts; 0 never sorts.
+    int interval = 0;
+    // Side of the cells the curve walks, in pixels. Particles sharing a
+    // cell keep their relative order.
+    float cellSize = 4.0f;
+};
+
+// Interleaves the low 16 bits of column and row, column in the even bits.
+uint32_t encodeMorton(uint32_t column, uint32_t row);
+
+// Stable LSD radix sort of keys on their low keyBits bits, 8 bits per pass.
+// order comes back holding the original index of each sorted key. Passes
+// run over fixed chunks of keys, so the thread count cannot change the
+// result.
+void radixSortByKey(std::vector<uint32_t>& keys, std::vector<int>& order, int keyBits, JobSystem* jobs = nullptr);
+
+// Sorts particles into Z-order so neighbors in space are mostly neighbors
+// in memory. Spawning appends and compaction moves the last particle into
+// each hole, which scatters them over time; a periodic sort puts them back.
+class MortonSorter {
+public:
+    // Reorders the live particles of pool along the Z-order curve through
+    // cells of cellSize over their bounds. Handles follow their particles.
+    void sort(ParticlePool& pool, float cellSize, JobSystem* jobs = nullptr);
+
+private:
+    std::vector<uint32_t> keys;
+    std::vector<int> order;
+};
+
+#endif // !MORTON_ORDER_H
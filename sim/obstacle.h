@@ -0,0 +1,23 @@
+#ifndef OBSTACLE_H
+#define OBSTACLE_H
+
+#include <glm/glm.hpp>
+
+enum ObstacleType {
+    OBSTACLE_SQUARE = 0,
+    OBSTACLE_TRIANGLE = 1,
+    OBSTACLE_CIRCLE = 2,
+    // A PolygonShape's outline, scaled by size.
+    OBSTACLE_POLYGON = 3,
+    OBSTACLE_TYPE_COUNT
+};
+
+struct Obstacle {
+    glm::vec2 position;
+    float size;
+    int type; // 0 = square, 1 = triangle, 2 = circle, 3 = polygon
+    // Index of the PolygonShape of a polygon; -1 for the other types.
+    int shape = -1;
+};
+
+#endif // !OBSTACLE_H
@@ -0,0 +1,184 @@
+#include "obstacle_colliders.h"
+#include <cfloat>
+
+// Edge function of p0 -> p1 as n . p + d, scaled by sign and normalized so
+// that it gives the signed distance to the edge.
+static void setEdge(float& nx, float& ny, float& d, glm::vec2 p0, glm::vec2 p1, float sign) {
+    glm::vec2 edge = p1 - p0;
+    sign /= glm::length(edge);
+    nx = -edge.y * sign;
+    ny = edge.x * sign;
+    d = (edge.y * p0.x - edge.x * p0.y) * sign;
+}
+
+// Every column of a type, so growing, shrinking and swapping treat them
+// alike.
+static std::vector<std::vector<float>*> getColumns(ObstacleColliders& colliders, int type) {
+    if (type == OBSTACLE_SQUARE) {
+        SquareColliders& s = colliders.squares;
+        return { &s.minX, &s.minY, &s.maxX, &s.maxY };
+    }
+    if (type == OBSTACLE_TRIANGLE) {
+        TriangleColliders& t = colliders.triangles;
+        return { &t.nx0, &t.ny0, &t.d0, &t.nx1, &t.ny1, &t.d1, &t.nx2, &t.ny2, &t.d2, &t.minX, &t.minY, &t.maxX, &t.maxY };
+    }
+    if (type == OBSTACLE_CIRCLE) {
+        CircleColliders& c = colliders.circles;
+        return { &c.x, &c.y, &c.radius, &c.radiusSquared };
+    }
+    PolygonColliders& p = colliders.polygons;
+    return { &p.minX, &p.minY, &p.maxX, &p.maxY };
+}
+
+static int roundUpToChunk(int edges) {
+    return (edges + POLYGON_EDGE_CHUNK - 1) / POLYGON_EDGE_CHUNK * POLYGON_EDGE_CHUNK;
+}
+
+int ObstacleColliders::add(const Obstacle& obstacle, const PolygonShape* shape) {
+    if (obstacle.type < 0 || obstacle.type >= OBSTACLE_TYPE_COUNT) return -1;
+    if (obstacle.type == OBSTACLE_POLYGON && !shape) return -1;
+    int index = getCount(obstacle.type);
+    for (std::vector<float>* column : getColumns(*this, obstacle.type)) {
+        column->push_back(0.0f);
+    }
+    if (obstacle.type == OBSTACLE_POLYGON) {
+        polygons.firstEdge.push_back(static_cast<int>(polygons.x.size()));
+        polygons.edgeCount.push_back(0);
+    }
+    set(index, obstacle, shape);
+    return index;
+}
+
+void ObstacleColliders::set(int j, const Obstacle& obstacle, const PolygonShape* shape) {
+    float half = obstacle.size / 2;
+
+    if (obstacle.type == OBSTACLE_SQUARE) {
+        squares.minX[j] = obstacle.position.x - half;
+        squares.minY[j] = obstacle.position.y - half;
+        squares.maxX[j] = obstacle.position.x + half;
+        squares.maxY[j] = obstacle.position.y + half;
+    }
+    else if (obstacle.type == OBSTACLE_TRIANGLE) {
+        glm::vec2 a = obstacle.position + glm::vec2(0, -half);
+        glm::vec2 b = obstacle.position + glm::vec2(-half, half);
+        glm::vec2 c = obstacle.position + glm::vec2(half, half);
+        glm::vec2 ab = b - a, ac = c - a;
+        float sign = (ab.x * ac.y - ab.y * ac.x) >= 0.0f ? 1.0f : -1.0f;
+        setEdge(triangles.nx0[j], triangles.ny0[j], triangles.d0[j], a, b, sign);
+        setEdge(triangles.nx1[j], triangles.ny1[j], triangles.d1[j], b, c, sign);
+        setEdge(triangles.nx2[j], triangles.ny2[j], triangles.d2[j], c, a, sign);
+        triangles.minX[j] = obstacle.position.x - half;
+        triangles.minY[j] = obstacle.position.y - half;
+        triangles.maxX[j] = obstacle.position.x + half;
+        triangles.maxY[j] = obstacle.position.y + half;
+    }
+    else if (obstacle.type == OBSTACLE_CIRCLE) {
+        circles.x[j] = obstacle.position.x;
+        circles.y[j] = obstacle.position.y;
+        circles.radius[j] = half;
+        circles.radiusSquared[j] = half * half;
+    }
+    else if (obstacle.type == OBSTACLE_POLYGON && shape) {
+        setPolygon(j, obstacle, *shape);
+    }
+}
+
+// A run only moves when its chunk count changes; moving or resizing keeps
+// the shape and rewrites the edges in place.
+void ObstacleColliders::setPolygon(int j, const Obstacle& obstacle, const PolygonShape& shape) {
+    int count = static_cast<int>(shape.outline.size());
+    int padded = roundUpToChunk(count);
+    int current = roundUpToChunk(polygons.edgeCount[j]);
+    if (padded != current) {
+        eraseEdges(polygons.firstEdge[j], current);
+        polygons.firstEdge[j] = static_cast<int>(polygons.x.size());
+        for (std::vector<float>* column : { &polygons.x, &polygons.y, &polygons.dx, &polygons.dy, &polygons.nx, &polygons.ny }) {
+            column->resize(column->size() + padded, 0.0f);
+        }
+        for (std::vector<float>* column : { &polygons.chunkMinX, &polygons.chunkMinY, &polygons.chunkMaxX, &polygons.chunkMaxY }) {
+            column->resize(column->size() + padded / POLYGON_EDGE_CHUNK, 0.0f);
+        }
+    }
+    polygons.edgeCount[j] = count;
+
+    int first = polygons.firstEdge[j];
+    for (int chunk = 0; chunk < padded; chunk += POLYGON_EDGE_CHUNK) {
+        glm::vec2 low(FLT_MAX), high(-FLT_MAX);
+        for (int k = chunk; k < chunk + POLYGON_EDGE_CHUNK; ++k) {
+            int e = first + k;
+            if (k >= count) {
+                polygons.x[e] = polygons.y[e] = polygons.dx[e] = polygons.dy[e] = polygons.nx[e] = polygons.ny[e] = 0.0f;
+                continue;
+            }
+            glm::vec2 p0 = obstacle.position + shape.outline[k] * obstacle.size;
+            glm::vec2 p1 = obstacle.position + shape.outline[(k + 1) % count] * obstacle.size;
+            glm::vec2 edge = p1 - p0;
+            float length = glm::length(edge);
+            polygons.x[e] = p0.x;
+            polygons.y[e] = p0.y;
+            polygons.dx[e] = edge.x;
+            polygons.dy[e] = edge.y;
+            polygons.nx[e] = edge.y / length;
+            polygons.ny[e] = -edge.x / length;
+            low = glm::min(low, glm::min(p0, p1));
+            high = glm::max(high, glm::max(p0, p1));
+        }
+        int c = (first + chunk) / POLYGON_EDGE_CHUNK;
+        polygons.chunkMinX[c] = low.x;
+        polygons.chunkMinY[c] = low.y;
+        polygons.chunkMaxX[c] = high.x;
+        polygons.chunkMaxY[c] = high.y;
+    }
+
+    glm::vec2 extent = shape.halfExtent * obstacle.size;
+    polygons.minX[j] = obstacle.position.x - extent.x;
+    polygons.minY[j] = obstacle.position.y - extent.y;
+    polygons.maxX[j] = obstacle.position.x + extent.x;
+    polygons.maxY[j] = obstacle.position.y + extent.y;
+}
+
+// Closes the gap left by edges [first, first + count), a whole number of
+// chunks, and moves the runs behind it down.
+void ObstacleColliders::eraseEdges(int first, int count) {
+    if (count == 0) return;
+    for (std::vector<float>* column : { &polygons.x, &polygons.y, &polygons.dx, &polygons.dy, &polygons.nx, &polygons.ny }) {
+        column->erase(column->begin() + first, column->begin() + first + count);
+    }
+    int firstChunk = first / POLYGON_EDGE_CHUNK, chunks = count / POLYGON_EDGE_CHUNK;
+    for (std::vector<float>* column : { &polygons.chunkMinX, &polygons.chunkMinY, &polygons.chunkMaxX, &polygons.chunkMaxY }) {
+        column->erase(column->begin() + firstChunk, column->begin() + firstChunk + chunks);
+    }
+    for (int& start : polygons.firstEdge) {
+        if (start > first) start -= count;
+    }
+}
+
+void ObstacleColliders::remove(int type, int index) {
+    if (type == OBSTACLE_POLYGON) {
+        eraseEdges(polygons.firstEdge[index], roundUpToChunk(polygons.edgeCount[index]));
+        for (std::vector<int>* column : { &polygons.firstEdge, &polygons.edgeCount }) {
+            (*column)[index] = column->back();
+            column->pop_back();
+        }
+    }
+    for (std::vector<float>* column : getColumns(*this, type)) {
+        (*column)[index] = column->back();
+        column->pop_back();
+    }
+}
+
+void ObstacleColliders::clear() {
+    *this = ObstacleColliders();
+}
+
+int ObstacleColliders::getCount(int type) const {
+    if (type == OBSTACLE_SQUARE) return static_cast<int>(squares.minX.size());
+    if (type == OBSTACLE_TRIANGLE) return static_cast<int>(triangles.nx0.size());
+    if (type == OBSTACLE_CIRCLE) return static_cast<int>(circles.x.size());
+    if (type == OBSTACLE_POLYGON) return static_cast<int>(polygons.minX.size());
+    return 0;
+}
+
+int ObstacleColliders::getTotalCount() const {
+    return getCount(OBSTACLE_SQUARE) + getCount(OBSTACLE_TRIANGLE) + getCount(OBSTACLE_CIRCLE) + getCount(OBSTACLE_POLYGON);
+}
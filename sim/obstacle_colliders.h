@@ -0,0 +1,73 @@
+#ifndef OBSTACLE_COLLIDERS_H
+#define OBSTACLE_COLLIDERS_H
+
+#include <vector>
+#include "obstacle.h"
+#include "polygon_shape.h"
+
+// Edges per chunk of a polygon's edge run; each chunk has its own bounds.
+const int POLYGON_EDGE_CHUNK = 16;
+
+// Axis-aligned bounds; inside is the open box.
+struct SquareColliders {
+    std::vector<float> minX, minY, maxX, maxY;
+};
+
+// Three edge equations per triangle, oriented so that a point is inside
+// (boundary included) when nx * x + ny * y + d >= 0 holds for all of them.
+// (nx, ny) is the unit inward normal, so each equation is a signed distance.
+// The bounds allow a cheap reject before the edges are looked at.
+struct TriangleColliders {
+    std::vector<float> nx0, ny0, d0;
+    std::vector<float> nx1, ny1, d1;
+    std::vector<float> nx2, ny2, d2;
+    std::vector<float> minX, minY, maxX, maxY;
+};
+
+// Center, radius and squared radius; inside is the open disc.
+struct CircleColliders {
+    std::vector<float> x, y, radius, radiusSquared;
+};
+
+// Bounds and a run of edges per polygon. The edge table holds each edge's
+// start point, the vector to its end point and its unit outward normal.
+// Runs start on a chunk boundary and are padded to whole chunks with edges
+// whose normal is zero, which nothing can hit; chunk c covers edges
+// [c * POLYGON_EDGE_CHUNK, (c + 1) * POLYGON_EDGE_CHUNK).
+struct PolygonColliders {
+    std::vector<float> minX, minY, maxX, maxY;
+    std::vector<int> firstEdge, edgeCount;
+    std::vector<float> x, y, dx, dy, nx, ny;
+    std::vector<float> chunkMinX, chunkMinY, chunkMaxX, chunkMaxY;
+};
+
+// Collision-ready copy of the obstacle list, split by type into
+// structure-of-arrays with everything that does not depend on the particle
+// precomputed. Indices are per type, in the order obstacles were added
+// until one is removed.
+class ObstacleColliders {
+public:
+    // Appends obstacle to its type and returns its index there. Polygons
+    // need their shape.
+    int add(const Obstacle& obstacle, const PolygonShape* shape = nullptr);
+    // Overwrites collider index of obstacle's type with obstacle.
+    void set(int index, const Obstacle& obstacle, const PolygonShape* shape = nullptr);
+    // Removes collider index of type; the last one of the type takes its
+    // index.
+    void remove(int type, int index);
+    void clear();
+
+    int getCount(int type) const;
+    int getTotalCount() const;
+
+    SquareColliders squares;
+    TriangleColliders triangles;
+    CircleColliders circles;
+    PolygonColliders polygons;
+
+private:
+    void setPolygon(int index, const Obstacle& obstacle, const PolygonShape& shape);
+    void eraseEdges(int first, int count);
+};
+
+#endif // !OBSTACLE_COLLIDERS_H
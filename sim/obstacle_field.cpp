@@ -0,0 +1,173 @@
+#include "obstacle_field.h"
+#include <algorithm>
+#include "config.h"
+
+// Stale regions kept apart before the whole field is rebaked instead.
+static const size_t MAX_STALE_REGIONS = 64;
+
+static void runParallel(JobSystem* jobs, int count, int chunkSize, const std::function<void(int, int, int)>& body) {
+    if (jobs) {
+        jobs->parallelFor(count, chunkSize, body);
+    }
+    else {
+        body(0, count, 0);
+    }
+}
+
+static float boxDistance(glm::vec2 p, glm::vec2 center, float half) {
+    glm::vec2 q = glm::abs(p - center) - glm::vec2(half);
+    return glm::length(glm::max(q, glm::vec2(0.0f))) + std::min(std::max(q.x, q.y), 0.0f);
+}
+
+static float circleDistance(glm::vec2 p, glm::vec2 center, float radius) {
+    return glm::length(p - center) - radius;
+}
+
+// Exact distance to triangle abc: to the nearest edge, negative inside.
+static float triangleDistance(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+    glm::vec2 e0 = b - a, e1 = c - b, e2 = a - c;
+    glm::vec2 v0 = p - a, v1 = p - b, v2 = p - c;
+    glm::vec2 q0 = v0 - e0 * glm::clamp(glm::dot(v0, e0) / glm::dot(e0, e0), 0.0f, 1.0f);
+    glm::vec2 q1 = v1 - e1 * glm::clamp(glm::dot(v1, e1) / glm::dot(e1, e1), 0.0f, 1.0f);
+    glm::vec2 q2 = v2 - e2 * glm::clamp(glm::dot(v2, e2) / glm::dot(e2, e2), 0.0f, 1.0f);
+    float nearest = std::min(std::min(glm::dot(q0, q0), glm::dot(q1, q1)), glm::dot(q2, q2));
+    // Inside when p is on the same side of all three edges.
+    float orientation = e0.x * e2.y - e0.y * e2.x;
+    float s0 = orientation * (v0.x * e0.y - v0.y * e0.x);
+    float s1 = orientation * (v1.x * e1.y - v1.y * e1.x);
+    float s2 = orientation * (v2.x * e2.y - v2.y * e2.x);
+    bool inside = s0 >= 0.0f && s1 >= 0.0f && s2 >= 0.0f;
+    return inside ? -std::sqrt(nearest) : std::sqrt(nearest);
+}
+
+ObstacleField::ObstacleField() : width(0), height(0), cellSize(0.0f), band(0.0f), allStale(true) {
+}
+
+void ObstacleField::invalidate(glm::vec2 minBound, glm::vec2 maxBound) {
+    if (allStale) return;
+    if (staleBounds.size() >= 2 * MAX_STALE_REGIONS) {
+        invalidateAll();
+        return;
+    }
+    staleBounds.push_back(minBound);
+    staleBounds.push_back(maxBound);
+}
+
+void ObstacleField::invalidateAll() {
+    allStale = true;
+    staleBounds.clear();
+}
+
+void ObstacleField::sync(const std::vector<Obstacle>& obstacles, const std::vector<PolygonShape>& shapes, const ObstacleTree& tree,
+    const std::vector<int> (&owners)[OBSTACLE_TYPE_COUNT], const ObstacleFieldSettings& settings, JobSystem* jobs) {
+    float newCellSize = std::max(settings.cellSize, 0.25f);
+    float newBand = std::max(settings.band, newCellSize);
+    if (newCellSize != cellSize || newBand != band) {
+        cellSize = newCellSize;
+        band = newBand;
+        width = static_cast<int>(std::ceil(SCR_WIDTH / cellSize)) + 1;
+        height = static_cast<int>(std::ceil(SCR_HEIGHT / cellSize)) + 1;
+        distance.resize(static_cast<size_t>(width) * height);
+        invalidateAll();
+    }
+
+    if (allStale) {
+        nearby.resize(obstacles.size());
+        for (size_t i = 0; i < obstacles.size(); ++i) nearby[i] = static_cast<int>(i);
+        rebake({ 0, 0, width - 1, height - 1 }, obstacles, nearby, shapes, jobs);
+        allStale = false;
+        return;
+    }
+    for (size_t i = 0; i < staleBounds.size(); i += 2) {
+        Region region;
+        if (!getRegion(staleBounds[i] - glm::vec2(band), staleBounds[i + 1] + glm::vec2(band), region)) continue;
+        // The obstacles that reach a sample of the region are those within
+        // band of it.
+        glm::vec2 low = glm::vec2(region.minColumn, region.minRow) * cellSize - glm::vec2(band);
+        glm::vec2 high = glm::vec2(region.maxColumn, region.maxRow) * cellSize + glm::vec2(band);
+        nearby.clear();
+        tree.query(low, high, [&](int type, int collider) {
+            nearby.push_back(owners[type][collider]);
+        });
+        rebake(region, obstacles, nearby, shapes, jobs);
+    }
+    staleBounds.clear();
+}
+
+bool ObstacleField::getRegion(glm::vec2 minBound, glm::vec2 maxBound, Region& region) const {
+    region.minColumn = std::max(static_cast<int>(std::floor(minBound.x / cellSize)), 0);
+    region.minRow = std::max(static_cast<int>(std::floor(minBound.y / cellSize)), 0);
+    region.maxColumn = std::min(static_cast<int>(std::ceil(maxBound.x / cellSize)), width - 1);
+    region.maxRow = std::min(static_cast<int>(std::ceil(maxBound.y / cellSize)), height - 1);
+    return region.minColumn <= region.maxColumn && region.minRow <= region.maxRow;
+}
+
+// Resets the region to the band, then bakes in each of the nearby
+// obstacles over the part of the region it can reach. Samples only ever
+// take the minimum, so the order of nearby does not matter.
+void ObstacleField::rebake(const Region& region, const std::vector<Obstacle>& obstacles, const std::vector<int>& nearby,
+    const std::vector<PolygonShape>& shapes, JobSystem* jobs) {
+    runParallel(jobs, region.maxRow - region.minRow + 1, 16, [&](int begin, int end, int) {
+        for (int row = region.minRow + begin; row < region.minRow + end; ++row) {
+            float* line = &distance[static_cast<size_t>(row) * width];
+            std::fill(line + region.minColumn, line + region.maxColumn + 1, band);
+        }
+    });
+
+    for (int index : nearby) {
+        const Obstacle& obstacle = obstacles[index];
+        float half = obstacle.size / 2;
+        Region reach;
+        if (!getRegion(obstacle.position - glm::vec2(half + band), obstacle.position + glm::vec2(half + band), reach)) continue;
+        reach.minColumn = std::max(reach.minColumn, region.minColumn);
+        reach.minRow = std::max(reach.minRow, region.minRow);
+        reach.maxColumn = std::min(reach.maxColumn, region.maxColumn);
+        reach.maxRow = std::min(reach.maxRow, region.maxRow);
+        if (reach.minColumn > reach.maxColumn || reach.minRow > reach.maxRow) continue;
+
+        glm::vec2 a = obstacle.position + glm::vec2(0, -half);
+        glm::vec2 b = obstacle.position + glm::vec2(-half, half);
+        glm::vec2 c = obstacle.position + glm::vec2(half, half);
+        runParallel(jobs, reach.maxRow - reach.minRow + 1, 16, [&](int begin, int end, int) {
+            for (int row = reach.minRow + begin; row < reach.minRow + end; ++row) {
+                float* line = &distance[static_cast<size_t>(row) * width];
+                for (int column = reach.minColumn; column <= reach.maxColumn; ++column) {
+                    glm::vec2 p(column * cellSize, row * cellSize);
+                    float d;
+                    if (obstacle.type == OBSTACLE_SQUARE) d = boxDistance(p, obstacle.position, half);
+                    else if (obstacle.type == OBSTACLE_TRIANGLE) d = triangleDistance(p, a, b, c);
+                    else if (obstacle.type == OBSTACLE_CIRCLE) d = circleDistance(p, obstacle.position, half);
+                    else d = polygonDistance(p, shapes[obstacle.shape], obstacle.position, obstacle.size);
+                    line[column] = std::max(std::min(line[column], d), -band);
+                }
+            }
+        });
+    }
+}
+
+float ObstacleField::distanceAt(glm::vec2 position) const {
+    if (distance.empty()) return band;
+    int column, row;
+    float fx, fy;
+    splitFieldCoordinate(position.x / cellSize, width, column, fx);
+    splitFieldCoordinate(position.y / cellSize, height, row, fy);
+    const float* sample = &distance[static_cast<size_t>(row) * width + column];
+    return (sample[0] * (1.0f - fx) + sample[1] * fx) * (1.0f - fy) + (sample[width] * (1.0f - fx) + sample[width + 1] * fx) * fy;
+}
+
+ObstacleFieldView ObstacleField::getView() const {
+    ObstacleFieldView view;
+    view.distance = distance.data();
+    view.width = width;
+    view.height = height;
+    view.inverseCellSize = cellSize > 0.0f ? 1.0f / cellSize : 0.0f;
+    return view;
+}
+
+void collideObstacleField(const ParticleColumns& p, const ObstacleField& field) {
+    if (field.getWidth() < 2 || field.getHeight() < 2) return;
+    ObstacleFieldView view = field.getView();
+    for (int i = 0, count = p.count; i < count; ++i) {
+        resolveFieldContact(view, p.lifetime[i] > 0.0f, p.x[i], p.y[i], p.vx[i], p.vy[i]);
+    }
+}
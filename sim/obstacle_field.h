@@ -0,0 +1,122 @@
+#ifndef OBSTACLE_FIELD_H
+#define OBSTACLE_FIELD_H
+
+#include <glm/glm.hpp>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+#include "job_system.h"
+#include "obstacle.h"
+#include "obstacle_tree.h"
+#include "particle_pool.h"
+#include "polygon_shape.h"
+
+struct ObstacleFieldSettings {
+    bool enabled = false;
+    // Spacing of the distance samples, in pixels.
+    float cellSize = 2.0f;
+    // Distances are exact within this many pixels of a surface and clamped
+    // beyond. A particle moving further than this in one step can end up
+    // deep inside an obstacle, where it is let out rather than bounced.
+    float band = 16.0f;
+};
+
+// Read-only view of the samples for the collision kernels.
+struct ObstacleFieldView {
+    const float* distance;
+    int width, height;
+    float inverseCellSize;
+};
+
+// Signed distance to the nearest obstacle, negative inside, sampled on a
+// grid over the SCR_WIDTH x SCR_HEIGHT world. Every sample is the exact
+// distance to the union of the obstacles' shapes, clamped to the band, so
+// an obstacle only affects the samples within band of its bounds. Adding,
+// moving, resizing or removing one marks just that region stale, and only
+// stale regions are rebaked, each from the obstacles the tree finds near
+// it. Collision then costs one bilinear sample per
+// particle whatever the number or shape of the obstacles.
+class ObstacleField {
+public:
+    ObstacleField();
+
+    // Marks the samples the box [minBound, maxBound] affects as stale.
+    void invalidate(glm::vec2 minBound, glm::vec2 maxBound);
+    // Marks every sample stale.
+    void invalidateAll();
+    // Rebakes the stale samples from obstacles, or everything when the
+    // settings changed. shapes are the outlines polygons refer to. tree
+    // holds every obstacle, and owners[type][collider] maps its leaves
+    // back to indices into obstacles.
+    void sync(const std::vector<Obstacle>& obstacles, const std::vector<PolygonShape>& shapes, const ObstacleTree& tree,
+        const std::vector<int> (&owners)[OBSTACLE_TYPE_COUNT], const ObstacleFieldSettings& settings, JobSystem* jobs = nullptr);
+
+    // Bilinear distance at position; positions outside the world get the
+    // value at its edge.
+    float distanceAt(glm::vec2 position) const;
+
+    ObstacleFieldView getView() const;
+    int getWidth() const { return width; }
+    int getHeight() const { return height; }
+
+private:
+    // Samples [minColumn, maxColumn] x [minRow, maxRow].
+    struct Region {
+        int minColumn, minRow, maxColumn, maxRow;
+    };
+
+    bool getRegion(glm::vec2 minBound, glm::vec2 maxBound, Region& region) const;
+    void rebake(const Region& region, const std::vector<Obstacle>& obstacles, const std::vector<int>& nearby,
+        const std::vector<PolygonShape>& shapes, JobSystem* jobs);
+
+    std::vector<float> distance;
+    int width, height;
+    float cellSize, band;
+    std::vector<glm::vec2> staleBounds;
+    bool allStale;
+    // Indices of the obstacles a rebake looks at.
+    std::vector<int> nearby;
+};
+
+// Splits field coordinate u into the lower sample and the weight of the
+// upper one, clamped to [0, size - 1]; NaN lands on sample 0.
+inline void splitFieldCoordinate(float u, int size, int& sample, float& fraction) {
+    float last = static_cast<float>(size - 1);
+    u = u > 0.0f ? (u < last ? u : last) : 0.0f;
+    sample = static_cast<int>(u);
+    sample = sample < size - 2 ? sample : size - 2;
+    fraction = u - static_cast<float>(sample);
+}
+
+// Mirrors a live particle that ended its step inside an obstacle back out
+// across the surface, and reflects its velocity if it was moving in. The
+// normal is the gradient of the bilinear interpolant; where that vanishes,
+// deeper than the band, the particle is left alone.
+inline void resolveFieldContact(const ObstacleFieldView& field, bool alive, float& x, float& y, float& vx, float& vy) {
+    static const float SURFACE_OFFSET = 1e-2f;
+    int column, row;
+    float fx, fy;
+    splitFieldCoordinate(x * field.inverseCellSize, field.width, column, fx);
+    splitFieldCoordinate(y * field.inverseCellSize, field.height, row, fy);
+    const float* sample = field.distance + row * field.width + column;
+    float d00 = sample[0], d10 = sample[1], d01 = sample[field.width], d11 = sample[field.width + 1];
+    float d = (d00 * (1.0f - fx) + d10 * fx) * (1.0f - fy) + (d01 * (1.0f - fx) + d11 * fx) * fy;
+    float gx = (d10 - d00) * (1.0f - fy) + (d11 - d01) * fy;
+    float gy = (d01 - d00) * (1.0f - fx) + (d11 - d10) * fx;
+    float length = std::sqrt(gx * gx + gy * gy);
+    bool inside = alive & (d < 0.0f) & (length > 1e-6f);
+    float inverseLength = 1.0f / (inside ? length : 1.0f);
+    float nx = gx * inverseLength, ny = gy * inverseLength;
+    float push = inside ? SURFACE_OFFSET - 2.0f * d : 0.0f;
+    x += nx * push;
+    y += ny * push;
+    float approach = vx * nx + vy * ny;
+    float reflect = inside & (approach < 0.0f) ? 2.0f * approach : 0.0f;
+    vx -= reflect * nx;
+    vy -= reflect * ny;
+}
+
+// resolveFieldContact for every live particle in p.
+void collideObstacleField(const ParticleColumns& p, const ObstacleField& field);
+
+#endif // !OBSTACLE_FIELD_H
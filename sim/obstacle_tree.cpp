@@ -0,0 +1,284 @@
+#include "obstacle_tree.h"
+#include <algorithm>
+#include <cfloat>
+#include "morton_order.h"
+
+// How far a leaf's fat bounds reach past the obstacle's own, in pixels.
+static const float FAT_MARGIN = 8.0f;
+
+// A leaf whose fat bounds have grown further than this past the obstacle's,
+// after the obstacle shrank, is refitted so it stops catching queries.
+static const float LOOSE_MARGIN = 4.0f * FAT_MARGIN;
+
+static float perimeter(glm::vec2 minBound, glm::vec2 maxBound) {
+    return 2.0f * ((maxBound.x - minBound.x) + (maxBound.y - minBound.y));
+}
+
+ObstacleTree::ObstacleTree() : root(-1), freeList(-1), leafCount(0) {
+}
+
+int ObstacleTree::allocateNode() {
+    int node;
+    if (freeList >= 0) {
+        node = freeList;
+        freeList = nodes[node].parent;
+    }
+    else {
+        node = static_cast<int>(nodes.size());
+        nodes.push_back(Node());
+        queryNodes.push_back(QueryNode());
+    }
+    Node& n = nodes[node];
+    n.parent = n.child1 = n.child2 = -1;
+    n.height = 0;
+    n.type = n.index = -1;
+    return node;
+}
+
+void ObstacleTree::freeNode(int node) {
+    nodes[node].parent = freeList;
+    nodes[node].height = -1;
+    freeList = node;
+}
+
+int ObstacleTree::insert(glm::vec2 minBound, glm::vec2 maxBound, int type, int index) {
+    int leaf = allocateNode();
+    Node& n = nodes[leaf];
+    n.minBound = minBound - glm::vec2(FAT_MARGIN);
+    n.maxBound = maxBound + glm::vec2(FAT_MARGIN);
+    n.type = type;
+    n.index = index;
+    insertLeaf(leaf);
+    leafCount++;
+    return leaf;
+}
+
+void ObstacleTree::insert(const std::vector<Leaf>& leaves, std::vector<int>& proxies) {
+    if (leaves.empty()) return;
+    int count = static_cast<int>(leaves.size());
+    nodes.reserve(nodes.size() + 2 * leaves.size());
+    queryNodes.reserve(queryNodes.size() + 2 * leaves.size());
+    glm::vec2 low(FLT_MAX), high(-FLT_MAX);
+    for (const Leaf& leaf : leaves) {
+        low = glm::min(low, leaf.minBound + leaf.maxBound);
+        high = glm::max(high, leaf.minBound + leaf.maxBound);
+    }
+    // Keys place each center on a 65536-cell grid over the centers' bounds.
+    // The span is kept to at least a pixel, so centers that all share an x
+    // or a y, or a single leaf, get a finite scale.
+    glm::vec2 scale = 65535.0f / glm::max(high - low, glm::vec2(1.0f));
+    buildKeys.resize(count);
+    size_t first = proxies.size();
+    for (int i = 0; i < count; ++i) {
+        const Leaf& leaf = leaves[i];
+        int node = allocateNode();
+        Node& n = nodes[node];
+        n.minBound = leaf.minBound - glm::vec2(FAT_MARGIN);
+        n.maxBound = leaf.maxBound + glm::vec2(FAT_MARGIN);
+        n.type = leaf.type;
+        n.index = leaf.index;
+        proxies.push_back(node);
+        glm::vec2 cell = glm::clamp((leaf.minBound + leaf.maxBound - low) * scale, 0.0f, 65535.0f);
+        buildKeys[i] = encodeMorton(static_cast<uint32_t>(cell.x), static_cast<uint32_t>(cell.y));
+    }
+    radixSortByKey(buildKeys, buildOrder, 32);
+    for (int& leaf : buildOrder) {
+        leaf = proxies[first + leaf];
+    }
+    insertLeaf(buildSubtree(buildOrder.data(), count));
+    leafCount += count;
+}
+
+// Halving a run of leaves sorted along the Z-order curve splits them much
+// as a median split along alternating axes would, with no partitioning.
+int ObstacleTree::buildSubtree(const int* leaves, int count) {
+    if (count == 1) return leaves[0];
+    int half = count / 2;
+    int child1 = buildSubtree(leaves, half);
+    int child2 = buildSubtree(leaves + half, count - half);
+    int node = allocateNode();
+    nodes[node].child1 = child1;
+    nodes[node].child2 = child2;
+    nodes[child1].parent = node;
+    nodes[child2].parent = node;
+    refit(node);
+    return node;
+}
+
+void ObstacleTree::remove(int proxy) {
+    removeLeaf(proxy);
+    freeNode(proxy);
+    leafCount--;
+}
+
+bool ObstacleTree::move(int proxy, glm::vec2 minBound, glm::vec2 maxBound) {
+    const Node& n = nodes[proxy];
+    bool contained = n.minBound.x <= minBound.x && n.minBound.y <= minBound.y &&
+        n.maxBound.x >= maxBound.x && n.maxBound.y >= maxBound.y;
+    bool loose = n.minBound.x < minBound.x - LOOSE_MARGIN || n.minBound.y < minBound.y - LOOSE_MARGIN ||
+        n.maxBound.x > maxBound.x + LOOSE_MARGIN || n.maxBound.y > maxBound.y + LOOSE_MARGIN;
+    if (contained && !loose) return false;
+
+    removeLeaf(proxy);
+    nodes[proxy].minBound = minBound - glm::vec2(FAT_MARGIN);
+    nodes[proxy].maxBound = maxBound + glm::vec2(FAT_MARGIN);
+    insertLeaf(proxy);
+    return true;
+}
+
+void ObstacleTree::setIndex(int proxy, int index) {
+    nodes[proxy].index = index;
+    int parent = nodes[proxy].parent;
+    if (parent >= 0) queryNodes[parent].index[nodes[parent].child1 == proxy ? 0 : 1] = index;
+}
+
+void ObstacleTree::clear() {
+    nodes.clear();
+    queryNodes.clear();
+    root = -1;
+    freeList = -1;
+    leafCount = 0;
+}
+
+void ObstacleTree::insertLeaf(int leaf) {
+    if (root < 0) {
+        root = leaf;
+        nodes[root].parent = -1;
+        return;
+    }
+
+    // Walk down to the sibling that makes the new parent cheapest, where a
+    // node costs its perimeter and every ancestor pays for its growth.
+    glm::vec2 leafMin = nodes[leaf].minBound, leafMax = nodes[leaf].maxBound;
+    int index = root;
+    while (nodes[index].child1 >= 0) {
+        const Node& node = nodes[index];
+        float area = perimeter(node.minBound, node.maxBound);
+        float combined = perimeter(glm::min(node.minBound, leafMin), glm::max(node.maxBound, leafMax));
+        float cost = 2.0f * combined;
+        float inheritance = 2.0f * (combined - area);
+
+        float childCost[2];
+        int children[2] = { node.child1, node.child2 };
+        for (int k = 0; k < 2; ++k) {
+            const Node& child = nodes[children[k]];
+            float grown = perimeter(glm::min(child.minBound, leafMin), glm::max(child.maxBound, leafMax));
+            childCost[k] = (child.child1 < 0 ? grown : grown - perimeter(child.minBound, child.maxBound)) + inheritance;
+        }
+        if (cost < childCost[0] && cost < childCost[1]) break;
+        index = childCost[0] < childCost[1] ? children[0] : children[1];
+    }
+
+    int sibling = index;
+    int oldParent = nodes[sibling].parent;
+    int newParent = allocateNode();
+    Node& parent = nodes[newParent];
+    parent.parent = oldParent;
+    parent.minBound = glm::min(nodes[sibling].minBound, leafMin);
+    parent.maxBound = glm::max(nodes[sibling].maxBound, leafMax);
+    parent.height = nodes[sibling].height + 1;
+    parent.child1 = sibling;
+    parent.child2 = leaf;
+    if (oldParent >= 0) {
+        if (nodes[oldParent].child1 == sibling) nodes[oldParent].child1 = newParent;
+        else nodes[oldParent].child2 = newParent;
+    }
+    else {
+        root = newParent;
+    }
+    nodes[sibling].parent = newParent;
+    nodes[leaf].parent = newParent;
+
+    // Refit before balancing: leaf can be a whole batch subtree, taller
+    // than the height newParent was given, and balance() must see the
+    // real heights.
+    for (index = nodes[leaf].parent; index >= 0; index = nodes[index].parent) {
+        refit(index);
+        index = balance(index);
+    }
+}
+
+void ObstacleTree::removeLeaf(int leaf) {
+    if (leaf == root) {
+        root = -1;
+        return;
+    }
+
+    int parent = nodes[leaf].parent;
+    int grandParent = nodes[parent].parent;
+    int sibling = nodes[parent].child1 == leaf ? nodes[parent].child2 : nodes[parent].child1;
+    freeNode(parent);
+    if (grandParent < 0) {
+        root = sibling;
+        nodes[sibling].parent = -1;
+        return;
+    }
+
+    if (nodes[grandParent].child1 == parent) nodes[grandParent].child1 = sibling;
+    else nodes[grandParent].child2 = sibling;
+    nodes[sibling].parent = grandParent;
+    for (int index = grandParent; index >= 0; index = nodes[index].parent) {
+        refit(index);
+        index = balance(index);
+    }
+}
+
+void ObstacleTree::refit(int node) {
+    Node& n = nodes[node];
+    const Node& a = nodes[n.child1];
+    const Node& b = nodes[n.child2];
+    n.minBound = glm::min(a.minBound, b.minBound);
+    n.maxBound = glm::max(a.maxBound, b.maxBound);
+    n.height = 1 + std::max(a.height, b.height);
+
+    QueryNode& q = queryNodes[node];
+    const int children[2] = { n.child1, n.child2 };
+    for (int k = 0; k < 2; ++k) {
+        const Node& child = nodes[children[k]];
+        q.minX[k] = child.minBound.x;
+        q.minY[k] = child.minBound.y;
+        q.maxX[k] = child.maxBound.x;
+        q.maxY[k] = child.maxBound.y;
+        q.child[k] = children[k];
+        q.type[k] = child.child1 < 0 ? child.type : -1;
+        q.index[k] = child.index;
+    }
+}
+
+// Rotates the taller child of a up when the children's heights differ by
+// more than one, and returns the node now in a's place. Of the promoted
+// child's two children, the taller stays with it.
+int ObstacleTree::balance(int a) {
+    if (nodes[a].child1 < 0 || nodes[a].height < 2) return a;
+
+    int b = nodes[a].child1, c = nodes[a].child2;
+    int difference = nodes[c].height - nodes[b].height;
+    if (difference >= -1 && difference <= 1) return a;
+
+    int up = difference > 1 ? c : b;
+    int f = nodes[up].child1, g = nodes[up].child2;
+    int keep = nodes[f].height > nodes[g].height ? f : g;
+    int give = keep == f ? g : f;
+
+    nodes[up].parent = nodes[a].parent;
+    if (nodes[up].parent >= 0) {
+        Node& parent = nodes[nodes[up].parent];
+        if (parent.child1 == a) parent.child1 = up;
+        else parent.child2 = up;
+    }
+    else {
+        root = up;
+    }
+    nodes[a].parent = up;
+    nodes[up].child1 = a;
+    nodes[up].child2 = keep;
+
+    // a keeps its other child and takes the shorter grandchild in up's place.
+    if (up == c) nodes[a].child2 = give;
+    else nodes[a].child1 = give;
+    nodes[give].parent = a;
+
+    refit(a);
+    refit(up);
+    return up;
+}
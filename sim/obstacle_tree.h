@@ -0,0 +1,130 @@
+#ifndef OBSTACLE_TREE_H
+#define OBSTACLE_TREE_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+
+// Dynamic bounding volume tree over obstacle bounds, after Box2D's
+// b2DynamicTree. Each leaf holds fat bounds, the obstacle's own grown by a
+// margin, so an obstacle that moves or grows a little stays where it is and
+// only one that leaves its fat bounds is taken out and reinserted. Inserts
+// descend toward the sibling that adds the least perimeter, and rotations
+// keep the tree balanced, so queries stay logarithmic however the obstacle
+// sizes are mixed.
+//
+// Leaves carry the obstacle's type and its index among the colliders of
+// that type. Nodes are indices into one array; a leaf's index (its proxy)
+// is stable until it is removed.
+class ObstacleTree {
+public:
+    struct Leaf {
+        glm::vec2 minBound, maxBound;
+        int type, index;
+    };
+
+    ObstacleTree();
+
+    int insert(glm::vec2 minBound, glm::vec2 maxBound, int type, int index);
+    // Inserts a batch at once: the leaves are sorted along the Z-order curve
+    // through their centers and built into one balanced subtree, which is
+    // then inserted like a single leaf. Far cheaper than one insert per leaf
+    // for large batches, and the subtree answers queries faster. Appends
+    // each leaf's proxy to proxies.
+    void insert(const std::vector<Leaf>& leaves, std::vector<int>& proxies);
+    void remove(int proxy);
+    // New tight bounds for a leaf. Returns whether it had to be reinserted.
+    bool move(int proxy, glm::vec2 minBound, glm::vec2 maxBound);
+    void setIndex(int proxy, int index);
+    void clear();
+
+    bool isEmpty() const { return root < 0; }
+    int getHeight() const { return root < 0 ? 0 : nodes[root].height; }
+    int getLeafCount() const { return leafCount; }
+
+    // Calls visit(type, index) for each leaf whose fat bounds overlap the
+    // box [minBound, maxBound]. visit may not change the tree.
+    template <typename Visit>
+    void query(glm::vec2 minBound, glm::vec2 maxBound, Visit&& visit) const {
+        if (root < 0) return;
+        const Node& top = nodes[root];
+        if (top.child1 < 0) {
+            if (top.overlaps(minBound, maxBound)) visit(top.type, top.index);
+            return;
+        }
+        // Only internal nodes are pushed, and only once their box is known
+        // to overlap, so the pushes do not branch. Balanced, the tree stays
+        // far below QUERY_STACK_SIZE deep for any number of leaves that
+        // fits in memory; a deeper one moves the stack to the heap, as
+        // Box2D's b2GrowableStack does, rather than writing past it.
+        int fixedStack[QUERY_STACK_SIZE];
+        std::vector<int> grownStack;
+        int* stack = fixedStack;
+        int capacity = QUERY_STACK_SIZE;
+        int count = 0;
+        stack[count++] = root;
+        while (count > 0) {
+            if (count + 2 > capacity) {
+                if (stack == fixedStack) grownStack.assign(fixedStack, fixedStack + count);
+                capacity *= 2;
+                grownStack.resize(capacity);
+                stack = grownStack.data();
+            }
+            const QueryNode& node = queryNodes[stack[--count]];
+            for (int k = 0; k < 2; ++k) {
+                bool overlap = (node.minX[k] <= maxBound.x) & (node.maxX[k] >= minBound.x) &
+                    (node.minY[k] <= maxBound.y) & (node.maxY[k] >= minBound.y);
+                bool leaf = node.type[k] >= 0;
+                if (overlap & leaf) visit(node.type[k], node.index[k]);
+                stack[count] = node.child[k];
+                count += overlap & !leaf;
+            }
+        }
+    }
+
+private:
+    static const int QUERY_STACK_SIZE = 128;
+
+    struct Node {
+        glm::vec2 minBound, maxBound;
+        // Next free node while the node is unused.
+        int parent;
+        // Both -1 for leaves.
+        int child1, child2;
+        // 0 for leaves, -1 while unused.
+        int height;
+        int type, index;
+
+        bool overlaps(glm::vec2 low, glm::vec2 high) const {
+            return (minBound.x <= high.x) & (maxBound.x >= low.x) & (minBound.y <= high.y) & (maxBound.y >= low.y);
+        }
+    };
+
+    // What a query reads of an internal node: both children's bounds and,
+    // for leaf children, their payload (type -1 for internal ones), in one
+    // cache line. refit() keeps it in step with the children.
+    struct alignas(64) QueryNode {
+        float minX[2], minY[2], maxX[2], maxY[2];
+        int child[2];
+        int type[2], index[2];
+    };
+
+    int allocateNode();
+    void freeNode(int node);
+    void insertLeaf(int leaf);
+    int buildSubtree(const int* leaves, int count);
+    void removeLeaf(int leaf);
+    int balance(int node);
+    void refit(int node);
+
+    std::vector<Node> nodes;
+    std::vector<QueryNode> queryNodes;
+    // Morton keys of a batch's centers and its leaves in key order.
+    std::vector<uint32_t> buildKeys;
+    std::vector<int> buildOrder;
+    int root;
+    int freeList;
+    int leafCount;
+};
+
+#endif // !OBSTACLE_TREE_H
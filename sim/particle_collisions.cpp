@@ -0,0 +1,122 @@
+#include "particle_collisions.h"
+#include <algorithm>
+#include <cmath>
+#include <vector>
+
+// Particles per bucket that take part in collisions. A freshly spawned
+// burst puts thousands of particles on one point; without a cap every one
+// of them would test every other and the pass would turn O(N^2). A cell is
+// one diameter across, so at most four discs fit in it without overlapping
+// and the cap only bites in piles like that. It is on a particle's rank in
+// its own bucket, which both sides of a pair see alike, so every pair is
+// resolved from both sides or from neither.
+static const int MAX_BUCKET_PARTICLES = 8;
+
+static const int COLLISION_CHUNK_SIZE = 4096;
+
+// Unit directions for pairs sitting exactly on top of each other.
+static const glm::vec2 SEPARATION_DIRECTIONS[8] = {
+    glm::vec2(1.0f, 0.0f), glm::vec2(0.70710678f, 0.70710678f),
+    glm::vec2(0.0f, 1.0f), glm::vec2(-0.70710678f, 0.70710678f),
+    glm::vec2(-1.0f, 0.0f), glm::vec2(-0.70710678f, -0.70710678f),
+    glm::vec2(0.0f, -1.0f), glm::vec2(0.70710678f, -0.70710678f),
+};
+
+// Picked from both slots and flipped for the lower one, so the two sides of
+// a pair push in opposite directions.
+static glm::vec2 separationDirection(int self, int other) {
+    uint32_t low = static_cast<uint32_t>(self < other ? self : other);
+    uint32_t high = static_cast<uint32_t>(self < other ? other : self);
+    uint32_t h = low * 0x9e3779b1u ^ high * 0x85ebca6bu;
+    h ^= h >> 15;
+    glm::vec2 direction = SEPARATION_DIRECTIONS[h & 7];
+    return self < other ? -direction : direction;
+}
+
+void collideParticles(ParticlePool& pool, SpatialHash& hash, const ParticleCollisionSettings& settings, JobSystem* jobs) {
+    float diameter = 2.0f * settings.radius;
+    if (!(diameter > 0.0f)) return;
+    hash.build(pool, diameter, jobs);
+
+    const SpatialHash::SortedParticles& s = hash.getParticles();
+    float diameter2 = diameter * diameter;
+    // Each side of a pair takes half of the change in relative velocity.
+    float response = 0.5f * (1.0f + settings.restitution);
+
+    // Jacobi iteration with one weight per pair, 1 / the larger of the two
+    // contact counts, so a particle wedged between many is not flung out
+    // by the sum of them, a lone pair is exact, and the two sides of a
+    // pair get equal and opposite changes: momentum is conserved. The
+    // first pass finds the contacts of every particle among the first
+    // MAX_BUCKET_PARTICLES of their buckets and keeps them per chunk, so
+    // the second only has to read them back.
+    int count = hash.getCount();
+    std::vector<int> contactCounts(count), contactStarts(count);
+    std::vector<std::vector<int>> chunkContacts((count + COLLISION_CHUNK_SIZE - 1) / COLLISION_CHUNK_SIZE);
+    auto findContacts = [&](int begin, int end, int) {
+        uint32_t buckets[SpatialHash::MAX_NEIGHBOR_BUCKETS];
+        std::vector<int>& contacts = chunkContacts[begin / COLLISION_CHUNK_SIZE];
+        for (int i = begin; i < end; ++i) {
+            contactStarts[i] = static_cast<int>(contacts.size());
+            glm::vec2 position(s.x[i], s.y[i]);
+            if (i - hash.getBucketBegin(hash.getBucket(position)) >= MAX_BUCKET_PARTICLES) continue;
+            int bucketCount = hash.getNeighborBuckets(position, buckets);
+            for (int b = 0; b < bucketCount; ++b) {
+                int first = hash.getBucketBegin(buckets[b]);
+                int last = std::min(hash.getBucketEnd(buckets[b]), first + MAX_BUCKET_PARTICLES);
+                for (int j = first; j < last; ++j) {
+                    float dx = position.x - s.x[j], dy = position.y - s.y[j];
+                    if (j != i && dx * dx + dy * dy < diameter2) contacts.push_back(j);
+                }
+            }
+            contactCounts[i] = static_cast<int>(contacts.size()) - contactStarts[i];
+        }
+    };
+    auto resolve = [&](int begin, int end, int) {
+        const std::vector<int>& contacts = chunkContacts[begin / COLLISION_CHUNK_SIZE];
+        for (int i = begin; i < end; ++i) {
+            if (contactCounts[i] == 0) continue;
+            glm::vec2 position(s.x[i], s.y[i]);
+            glm::vec2 velocity(s.vx[i], s.vy[i]);
+            glm::vec2 push(0.0f), impulse(0.0f);
+            for (int c = contactStarts[i]; c < contactStarts[i] + contactCounts[i]; ++c) {
+                int j = contacts[c];
+                glm::vec2 offset(position.x - s.x[j], position.y - s.y[j]);
+                float distance2 = glm::dot(offset, offset);
+                glm::vec2 normal;
+                float distance = 0.0f;
+                if (distance2 > 0.0f) {
+                    distance = std::sqrt(distance2);
+                    normal = offset / distance;
+                }
+                else {
+                    normal = separationDirection(s.slot[i], s.slot[j]);
+                }
+                float weight = 1.0f / std::max(contactCounts[i], contactCounts[j]);
+                push += normal * (0.5f * (diameter - distance) * weight);
+                float approach = glm::dot(velocity - glm::vec2(s.vx[j], s.vy[j]), normal);
+                if (approach < 0.0f) impulse -= normal * (response * approach * weight);
+            }
+
+            int slot = s.slot[i];
+            ParticleColumns p = pool.getPage(slot >> PARTICLE_PAGE_SHIFT);
+            int entry = slot & (PARTICLE_PAGE_SIZE - 1);
+            p.x[entry] = position.x + push.x;
+            p.y[entry] = position.y + push.y;
+            p.vx[entry] = velocity.x + impulse.x;
+            p.vy[entry] = velocity.y + impulse.y;
+        }
+    };
+    if (jobs) {
+        jobs->parallelFor(count, COLLISION_CHUNK_SIZE, findContacts);
+        jobs->parallelFor(count, COLLISION_CHUNK_SIZE, resolve);
+    }
+    else {
+        for (int begin = 0; begin < count; begin += COLLISION_CHUNK_SIZE) {
+            findContacts(begin, std::min(begin + COLLISION_CHUNK_SIZE, count), 0);
+        }
+        for (int begin = 0; begin < count; begin += COLLISION_CHUNK_SIZE) {
+            resolve(begin, std::min(begin + COLLISION_CHUNK_SIZE, count), 0);
+        }
+    }
+}
@@ -0,0 +1,25 @@
+#ifndef PARTICLE_COLLISIONS_H
+#define PARTICLE_COLLISIONS_H
+
+#include "job_system.h"
+#include "particle_pool.h"
+#include "spatial_hash.h"
+
+// Particles as discs of equal mass that bounce off each other.
+struct ParticleCollisionSettings {
+    bool enabled = false;
+    float radius = 2.0f;
+    // Fraction of the approach speed along the contact normal a pair keeps;
+    // 1 is elastic.
+    float restitution = 1.0f;
+};
+
+// Separates overlapping live particles and reflects the normal component
+// of their relative velocity, with equal and opposite changes for the two
+// particles of every pair. Every particle reads its neighbors from the
+// snapshot in hash and writes only its own slot, so the pass runs in
+// parallel without races and gives the same result on any thread count.
+// Rebuilds hash with a cell size of one diameter.
+void collideParticles(ParticlePool& pool, SpatialHash& hash, const ParticleCollisionSettings& settings, JobSystem* jobs = nullptr);
+
+#endif // !PARTICLE_COLLISIONS_H
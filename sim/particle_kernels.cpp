@@ -0,0 +1,20 @@
+#include "particle_kernels.h"
+#include <cmath>
+
+void applyPointForce(const ParticleColumns& p, glm::vec2 point, float strength, float deltaTime) {
+    const float* PARTICLE_RESTRICT x = p.x;
+    const float* PARTICLE_RESTRICT y = p.y;
+    float* PARTICLE_RESTRICT vx = p.vx;
+    float* PARTICLE_RESTRICT vy = p.vy;
+    const float* PARTICLE_RESTRICT lifetime = p.lifetime;
+
+    for (int i = 0, count = p.count; i < count; ++i) {
+        float dx = point.x - x[i];
+        float dy = point.y - y[i];
+        float length = std::sqrt(dx * dx + dy * dy);
+        bool active = (length > 0.0f) & (lifetime[i] > 0.0f);
+        float divisor = active ? length : 1.0f;
+        vx[i] += active ? dx / divisor * strength * deltaTime : 0.0f;
+        vy[i] += active ? dy / divisor * strength * deltaTime : 0.0f;
+    }
+}
@@ -0,0 +1,18 @@
+#ifndef PARTICLE_KERNELS_H
+#define PARTICLE_KERNELS_H
+
+#include <glm/glm.hpp>
+#include "particle_pool.h"
+
+// Column kernels behind ParticleSystem::update. These are flat loops over
+// ParticleColumns with the alive test folded into a select, so the compiler
+// can vectorize them without per-particle branches. Obstacle collision lives
+// in collision_kernels.h; integration and confinement only exist fused into
+// the per-mode pass in update_kernels.h.
+
+// Pulls (strength > 0) or pushes (strength < 0) live particles towards point.
+// Gravity must act between this and the move, so with gravity on it runs as
+// its own pass instead of inside the fused one.
+void applyPointForce(const ParticleColumns& p, glm::vec2 point, float strength, float deltaTime);
+
+#endif // !PARTICLE_KERNELS_H
@@ -0,0 +1,274 @@
+#include "particle_mesh.h"
+#include <algorithm>
+#include <cmath>
+
+// Partial meshes the deposit is split over. Fixed, so the summation order
+// and with it the result do not depend on the thread count.
+static const int DEPOSIT_SLICES = 8;
+
+static const int MIN_MESH_SIZE = 8;
+
+// Ratio between neighboring mesh spans. The span shrinks only once the
+// bodies fit in span / MESH_SPAN_STEP^2, so bodies hovering around a step
+// do not rebuild the kernel back and forth.
+static const float MESH_SPAN_STEP = 1.41421356f;
+
+// std::complex multiplication goes through a NaN-checking library call
+// unless the whole build uses -ffast-math.
+static std::complex<float> multiply(std::complex<float> a, std::complex<float> b) {
+    return std::complex<float>(a.real() * b.real() - a.imag() * b.imag(), a.real() * b.imag() + a.imag() * b.real());
+}
+
+static void runParallel(JobSystem* jobs, int count, int chunkSize, const std::function<void(int, int, int)>& body) {
+    if (jobs) {
+        jobs->parallelFor(count, chunkSize, body);
+    }
+    else {
+        body(0, count, 0);
+    }
+}
+
+// Splits mesh coordinate u into the lower node and the weight of the upper
+// one, clamped to the mesh; NaN lands on node 0.
+static void splitCoordinate(float u, int size, int& node, float& fraction) {
+    float last = static_cast<float>(size - 1);
+    u = u > 0.0f ? (u < last ? u : last) : 0.0f;
+    node = std::min(static_cast<int>(u), size - 2);
+    fraction = u - static_cast<float>(node);
+}
+
+ParticleMeshSolver::ParticleMeshSolver()
+    : size(0), origin(0.0f), cellSize(1.0f), inverseCellSize(1.0f), meshSpan(0.0f),
+      kernelSize(0), kernelCellSize(0.0f), kernelSoftening(0.0f), kernelBuilds(0) {
+}
+
+void ParticleMeshSolver::solve(const ParticlePool& pool, int meshSize, float softening, JobSystem* jobs) {
+    // Between fluid substeps, slots that expired are still below the live
+    // count, since compaction only runs after the last substep. Only live
+    // particles are copied; every slot is written and the count advances
+    // past the live ones only.
+    std::vector<float> x(pool.getLiveCount()), y(pool.getLiveCount());
+    int count = 0;
+    for (int page = 0; page < pool.getLivePageCount(); ++page) {
+        ParticleColumns p = pool.getPage(page);
+        int live = std::min(pool.getLiveCount() - page * PARTICLE_PAGE_SIZE, PARTICLE_PAGE_SIZE);
+        for (int i = 0; i < live; ++i) {
+            x[count] = p.x[i];
+            y[count] = p.y[i];
+            count += p.lifetime[i] > 0.0f;
+        }
+    }
+    solve(x.data(), y.data(), count, meshSize, softening, jobs);
+}
+
+void ParticleMeshSolver::solve(const float* x, const float* y, int count, int meshSize, float softening, JobSystem* jobs) {
+    int newSize = MIN_MESH_SIZE;
+    while (newSize < meshSize) newSize <<= 1;
+    if (newSize != size) {
+        size = newSize;
+        int padded = 2 * size;
+        twiddles.resize(padded / 2);
+        for (int k = 0; k < padded / 2; ++k) {
+            double angle = -2.0 * 3.14159265358979323846 * k / padded;
+            twiddles[k] = std::complex<float>(static_cast<float>(std::cos(angle)), static_cast<float>(std::sin(angle)));
+        }
+        bitReverse.resize(padded);
+        int bits = 0;
+        while ((1 << bits) < padded) bits++;
+        for (int i = 0; i < padded; ++i) {
+            int reversed = 0;
+            for (int b = 0; b < bits; ++b) {
+                if (i & (1 << b)) reversed |= 1 << (bits - 1 - b);
+            }
+            bitReverse[i] = reversed;
+        }
+        kernelSize = 0;
+        meshSpan = 0.0f;
+    }
+    int cells = size * size;
+    mass.assign(cells, 0.0f);
+    accelerationX.assign(cells, 0.0f);
+    accelerationY.assign(cells, 0.0f);
+    if (count == 0) return;
+
+    // The bodies span at most size - 2 cells around the middle of the
+    // mesh, so every cloud lands on two nodes per axis.
+    glm::vec2 minBound(x[0], y[0]), maxBound(x[0], y[0]);
+    for (int i = 1; i < count; ++i) {
+        minBound = glm::min(minBound, glm::vec2(x[i], y[i]));
+        maxBound = glm::max(maxBound, glm::vec2(x[i], y[i]));
+    }
+    float extent = std::max(std::max(maxBound.x - minBound.x, maxBound.y - minBound.y), 1.0f);
+    if (extent > meshSpan || extent * (MESH_SPAN_STEP * MESH_SPAN_STEP) <= meshSpan) {
+        meshSpan = std::exp2(std::ceil(2.0f * std::log2(extent)) * 0.5f);
+        if (meshSpan < extent) meshSpan *= MESH_SPAN_STEP;
+    }
+    cellSize = meshSpan / (size - 2);
+    inverseCellSize = 1.0f / cellSize;
+    origin = 0.5f * (minBound + maxBound) - glm::vec2(0.5f * cellSize * (size - 1));
+
+    deposit(x, y, count, jobs);
+    updateKernel(softening, jobs);
+
+    // Mass goes into the top left quarter of the padded mesh; the rest
+    // stays zero so the convolution does not wrap.
+    int padded = 2 * size;
+    work.assign(static_cast<size_t>(padded) * padded, std::complex<float>(0.0f));
+    for (int row = 0; row < size; ++row) {
+        for (int column = 0; column < size; ++column) {
+            work[row * padded + column] = mass[row * size + column];
+        }
+    }
+    transform(work, size, false, jobs);
+    runParallel(jobs, padded, 16, [&](int begin, int end, int) {
+        for (int i = begin * padded; i < end * padded; ++i) {
+            work[i] = multiply(work[i], kernel[i]);
+        }
+    });
+    transform(work, size, true, jobs);
+
+    float scale = 1.0f / (static_cast<float>(padded) * padded);
+    float inverseTwoCells = 0.5f * inverseCellSize;
+    runParallel(jobs, size, 16, [&](int begin, int end, int) {
+        for (int row = begin; row < end; ++row) {
+            int up = std::max(row - 1, 0), down = std::min(row + 1, size - 1);
+            for (int column = 0; column < size; ++column) {
+                int left = std::max(column - 1, 0), right = std::min(column + 1, size - 1);
+                // One-sided at the border, where the span is one cell.
+                float dx = (work[row * padded + right].real() - work[row * padded + left].real()) * (right - left == 2 ? inverseTwoCells : inverseCellSize);
+                float dy = (work[down * padded + column].real() - work[up * padded + column].real()) * (down - up == 2 ? inverseTwoCells : inverseCellSize);
+                accelerationX[row * size + column] = -dx * scale;
+                accelerationY[row * size + column] = -dy * scale;
+            }
+        }
+    });
+}
+
+void ParticleMeshSolver::deposit(const float* x, const float* y, int count, JobSystem* jobs) {
+    int cells = size * size;
+    partialMass.assign(static_cast<size_t>(DEPOSIT_SLICES) * cells, 0.0f);
+    runParallel(jobs, DEPOSIT_SLICES, 1, [&](int begin, int end, int) {
+        for (int slice = begin; slice < end; ++slice) {
+            float* grid = &partialMass[static_cast<size_t>(slice) * cells];
+            int first = static_cast<int>(static_cast<long long>(count) * slice / DEPOSIT_SLICES);
+            int last = static_cast<int>(static_cast<long long>(count) * (slice + 1) / DEPOSIT_SLICES);
+            for (int i = first; i < last; ++i) {
+                int column, row;
+                float fx, fy;
+                splitCoordinate((x[i] - origin.x) * inverseCellSize, size, column, fx);
+                splitCoordinate((y[i] - origin.y) * inverseCellSize, size, row, fy);
+                float* node = grid + row * size + column;
+                node[0] += (1.0f - fx) * (1.0f - fy);
+                node[1] += fx * (1.0f - fy);
+                node[size] += (1.0f - fx) * fy;
+                node[size + 1] += fx * fy;
+            }
+        }
+    });
+    runParallel(jobs, size, 16, [&](int begin, int end, int) {
+        for (int slice = 0; slice < DEPOSIT_SLICES; ++slice) {
+            const float* grid = &partialMass[static_cast<size_t>(slice) * cells];
+            for (int i = begin * size; i < end * size; ++i) {
+                mass[i] += grid[i];
+            }
+        }
+    });
+}
+
+// The Green's function only changes with the cell size, which only changes
+// when the mesh span steps.
+void ParticleMeshSolver::updateKernel(float softening, JobSystem* jobs) {
+    if (kernelSize == size && kernelCellSize == cellSize && kernelSoftening == softening) return;
+    ++kernelBuilds;
+    kernelSize = size;
+    kernelCellSize = cellSize;
+    kernelSoftening = softening;
+
+    int padded = 2 * size;
+    // A zero softening would put an infinity on the diagonal.
+    float softening2 = std::max(softening * softening, 1.0e-4f * cellSize * cellSize);
+    kernel.resize(static_cast<size_t>(padded) * padded);
+    runParallel(jobs, padded, 16, [&](int begin, int end, int) {
+        for (int row = begin; row < end; ++row) {
+            float dy = (row < size ? row : row - padded) * cellSize;
+            for (int column = 0; column < padded; ++column) {
+                float dx = (column < size ? column : column - padded) * cellSize;
+                kernel[row * padded + column] = -1.0f / std::sqrt(dx * dx + dy * dy + softening2);
+            }
+        }
+    });
+    transform(kernel, padded, false, jobs);
+}
+
+// 2D FFT of the padded mesh, rows then columns. Only rows [0, rows) can be
+// nonzero going forward and only they are wanted coming back, so the other
+// row transforms are skipped.
+void ParticleMeshSolver::transform(std::vector<std::complex<float>>& grid, int rows, bool inverse, JobSystem* jobs) const {
+    int padded = 2 * size;
+    auto transformRows = [&](int begin, int end, int) {
+        for (int row = begin; row < end; ++row) {
+            fft(&grid[static_cast<size_t>(row) * padded], inverse);
+        }
+    };
+    auto transformColumns = [&](int begin, int end, int) {
+        std::vector<std::complex<float>> column(padded);
+        for (int c = begin; c < end; ++c) {
+            for (int row = 0; row < padded; ++row) column[row] = grid[static_cast<size_t>(row) * padded + c];
+            fft(column.data(), inverse);
+            for (int row = 0; row < padded; ++row) grid[static_cast<size_t>(row) * padded + c] = column[row];
+        }
+    };
+    if (!inverse) {
+        runParallel(jobs, rows, 16, transformRows);
+        runParallel(jobs, padded, 16, transformColumns);
+    }
+    else {
+        runParallel(jobs, padded, 16, transformColumns);
+        runParallel(jobs, rows, 16, transformRows);
+    }
+}
+
+// In-place radix-2 transform of 2 * size points. The inverse is unscaled.
+void ParticleMeshSolver::fft(std::complex<float>* data, bool inverse) const {
+    int n = static_cast<int>(bitReverse.size());
+    for (int i = 0; i < n; ++i) {
+        if (i < bitReverse[i]) std::swap(data[i], data[bitReverse[i]]);
+    }
+    for (int half = 1; half < n; half <<= 1) {
+        int stride = n / (2 * half);
+        for (int start = 0; start < n; start += 2 * half) {
+            for (int k = 0; k < half; ++k) {
+                std::complex<float> w = twiddles[k * stride];
+                if (inverse) w = std::conj(w);
+                std::complex<float> a = data[start + k];
+                std::complex<float> b = multiply(data[start + k + half], w);
+                data[start + k] = a + b;
+                data[start + k + half] = a - b;
+            }
+        }
+    }
+}
+
+glm::vec2 ParticleMeshSolver::accelerationAt(glm::vec2 position) const {
+    if (size == 0) return glm::vec2(0.0f);
+    int column, row;
+    float fx, fy;
+    splitCoordinate((position.x - origin.x) * inverseCellSize, size, column, fx);
+    splitCoordinate((position.y - origin.y) * inverseCellSize, size, row, fy);
+    int node = row * size + column;
+    float w00 = (1.0f - fx) * (1.0f - fy), w10 = fx * (1.0f - fy), w01 = (1.0f - fx) * fy, w11 = fx * fy;
+    return glm::vec2(
+        w00 * accelerationX[node] + w10 * accelerationX[node + 1] + w01 * accelerationX[node + size] + w11 * accelerationX[node + size + 1],
+        w00 * accelerationY[node] + w10 * accelerationY[node + 1] + w01 * accelerationY[node + size] + w11 * accelerationY[node + size + 1]);
+}
+
+void applyMeshGravity(const ParticleColumns& p, const ParticleMeshSolver& solver, const GravitySettings& settings, float deltaTime) {
+    float impulse = settings.strength * deltaTime;
+    if (impulse == 0.0f) return;
+    for (int i = 0, count = p.count; i < count; ++i) {
+        if (p.lifetime[i] <= 0.0f) continue;
+        glm::vec2 acceleration = solver.accelerationAt(glm::vec2(p.x[i], p.y[i]));
+        p.vx[i] += acceleration.x * impulse;
+        p.vy[i] += acceleration.y * impulse;
+    }
+}
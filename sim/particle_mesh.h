@@ -0,0 +1,75 @@
+#ifndef PARTICLE_MESH_H
+#define PARTICLE_MESH_H
+
+#include <glm/glm.hpp>
+#include <complex>
+#include <vector>
+#include "gravity.h"
+#include "job_system.h"
+#include "particle_pool.h"
+
+// Particle-mesh gravity. Bodies deposit their mass onto a square mesh
+// centered on their bounds with cloud-in-cell weights. The span the mesh
+// covers moves in steps of sqrt(2) rather than following the bounds
+// exactly, so the Green's function, which depends on the cell size, is
+// rebuilt only when the bodies outgrow the span or fit in half of it. The potential is
+// the mesh convolved with the softened Green's function -1 / sqrt(r^2 + e^2),
+// done with FFTs on a mesh padded to twice the size so the field does not
+// wrap around. That is the 3D kernel, as for a razor-thin disk, so the
+// forces match BarnesHutTree's wherever the mesh resolves them.
+// Accelerations are central differences of the potential, read back with
+// the same weights.
+//
+// Deposits go into a fixed number of partial meshes that are summed in
+// order, so the result does not depend on the thread count.
+class ParticleMeshSolver {
+public:
+    ParticleMeshSolver();
+
+    // Solves for the live particles of pool. meshSize is rounded up to a
+    // power of two.
+    void solve(const ParticlePool& pool, int meshSize, float softening, JobSystem* jobs = nullptr);
+    void solve(const float* x, const float* y, int count, int meshSize, float softening, JobSystem* jobs = nullptr);
+
+    // Acceleration at position per unit of GravitySettings::strength.
+    // Positions outside the mesh get the value at its edge.
+    glm::vec2 accelerationAt(glm::vec2 position) const;
+
+    int getMeshSize() const { return size; }
+    // Times the Green's function has been rebuilt since construction.
+    int getKernelBuildCount() const { return kernelBuilds; }
+
+private:
+    void deposit(const float* x, const float* y, int count, JobSystem* jobs);
+    void updateKernel(float softening, JobSystem* jobs);
+    void transform(std::vector<std::complex<float>>& grid, int rows, bool inverse, JobSystem* jobs) const;
+    void fft(std::complex<float>* data, bool inverse) const;
+
+    int size;
+    glm::vec2 origin;
+    float cellSize;
+    float inverseCellSize;
+    // Extent covered by size - 2 cells; 0 until the first solve at this
+    // size.
+    float meshSpan;
+    std::vector<float> mass;
+    std::vector<float> partialMass;
+    std::vector<float> accelerationX, accelerationY;
+
+    // FFT of the Green's function on the padded mesh, and what it was
+    // built for.
+    std::vector<std::complex<float>> kernel;
+    int kernelSize;
+    float kernelCellSize, kernelSoftening;
+    int kernelBuilds;
+
+    std::vector<std::complex<float>> work;
+    std::vector<std::complex<float>> twiddles;
+    std::vector<int> bitReverse;
+};
+
+// Adds strength * acceleration * deltaTime to the velocity of every live
+// particle in p.
+void applyMeshGravity(const ParticleColumns& p, const ParticleMeshSolver& solver, const GravitySettings& settings, float deltaTime);
+
+#endif // !PARTICLE_MESH_H
@@ -0,0 +1,24 @@
+#include "particle_packing.h"
+#include <cstring>
+
+// Restrict parameters rather than locals, which GCC does not trust enough
+// to vectorize. Color goes through a float so all four stores of a vertex
+// have one type and merge into a single vector store.
+static void packVertexColumns(const float* PARTICLE_RESTRICT x, const float* PARTICLE_RESTRICT y,
+    const float* PARTICLE_RESTRICT prevX, const float* PARTICLE_RESTRICT prevY,
+    const uint32_t* PARTICLE_RESTRICT color, const float* PARTICLE_RESTRICT lifetime,
+    int count, float alpha, ParticleVertex* PARTICLE_RESTRICT out) {
+    float beta = 1.0f - alpha;
+    for (int i = 0; i < count; ++i) {
+        float colorBits;
+        std::memcpy(&colorBits, &color[i], sizeof(colorBits));
+        out[i].position.x = prevX[i] * beta + x[i] * alpha;
+        out[i].position.y = prevY[i] * beta + y[i] * alpha;
+        std::memcpy(&out[i].color, &colorBits, sizeof(colorBits));
+        out[i].lifetime = lifetime[i];
+    }
+}
+
+void packVertices(const ParticleColumns& p, int count, float alpha, ParticleVertex* out) {
+    packVertexColumns(p.x, p.y, p.prevX, p.prevY, p.color, p.lifetime, count, alpha, out);
+}
@@ -0,0 +1,21 @@
+#ifndef PARTICLE_PACKING_H
+#define PARTICLE_PACKING_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include "particle_pool.h"
+
+// Point vertex the viewer draws. Color stays in the pool's RGBA8 form,
+// which halves the upload compared to a float vec4; lifetime drives the
+// color-over-life gradient in the shader.
+struct ParticleVertex {
+    glm::vec2 position;
+    uint32_t color;
+    float lifetime;
+};
+
+// Writes vertices for slots [0, count) of p, positioned alpha of the way
+// from the previous step's position to the current one.
+void packVertices(const ParticleColumns& p, int count, float alpha, ParticleVertex* out);
+
+#endif // !PARTICLE_PACKING_H
@@ -0,0 +1,283 @@
+#include "particle_pool.h"
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+static const uint32_t NO_HANDLE = 0xffffffffu;
+
+// x, y, prevX, prevY, vx, vy, lifetime, color and handle, four bytes each.
+static const int PAGE_COLUMNS = 9;
+
+ParticlePool::ParticlePool(int capacity) : capacity(0), liveCount(0) {
+    resize(capacity);
+}
+
+ParticlePool::~ParticlePool() {
+    for (Page& page : pages) {
+        freePage(page);
+    }
+}
+
+ParticlePool::Page ParticlePool::allocatePage() {
+    size_t columnBytes = PARTICLE_PAGE_SIZE * sizeof(float);
+    char* block = static_cast<char*>(::operator new(PAGE_COLUMNS * columnBytes, std::align_val_t(PARTICLE_ALIGNMENT)));
+    std::memset(block, 0, (PAGE_COLUMNS - 1) * columnBytes);
+
+    Page page;
+    float* floats[7];
+    for (int c = 0; c < 7; ++c) {
+        floats[c] = reinterpret_cast<float*>(block + c * columnBytes);
+    }
+    page.columns = { floats[0], floats[1], floats[2], floats[3], floats[4], floats[5], floats[6],
+        reinterpret_cast<uint32_t*>(block + 7 * columnBytes), PARTICLE_PAGE_SIZE };
+    page.handle = reinterpret_cast<uint32_t*>(block + 8 * columnBytes);
+    std::fill(page.handle, page.handle + PARTICLE_PAGE_SIZE, NO_HANDLE);
+    page.block = block;
+    return page;
+}
+
+void ParticlePool::freePage(Page& page) {
+    ::operator delete(page.block, std::align_val_t(PARTICLE_ALIGNMENT));
+    page.block = nullptr;
+}
+
+void ParticlePool::resize(int newCapacity) {
+    if (newCapacity < 0) newCapacity = 0;
+
+    // Shrinking drops whatever lived past the new capacity.
+    for (int slot = newCapacity; slot < liveCount; ++slot) {
+        kill(slot);
+    }
+    liveCount = std::min(liveCount, newCapacity);
+
+    size_t pageCount = (newCapacity + PARTICLE_PAGE_SIZE - 1) >> PARTICLE_PAGE_SHIFT;
+    while (pages.size() > pageCount) {
+        freePage(pages.back());
+        pages.pop_back();
+    }
+    while (pages.size() < pageCount) {
+        pages.push_back(allocatePage());
+    }
+    retiredHandles.resize(pages.size());
+    capacity = newCapacity;
+}
+
+ParticleColumns ParticlePool::getPage(int page) const {
+    int live = std::min(std::max(liveCount - (page << PARTICLE_PAGE_SHIFT), 0), PARTICLE_PAGE_SIZE);
+    ParticleColumns columns = pages[page].columns;
+    columns.count = (live + PARTICLE_SIMD_WIDTH - 1) / PARTICLE_SIMD_WIDTH * PARTICLE_SIMD_WIDTH;
+    return columns;
+}
+
+int ParticlePool::allocate(int count) {
+    int granted = std::max(0, std::min(count, capacity - liveCount));
+    liveCount += granted;
+    return granted;
+}
+
+void ParticlePool::compact(int first) {
+    int i = first;
+    while (i < liveCount) {
+        int entry;
+        if (pageOf(i, entry).columns.lifetime[entry] > 0.0f) {
+            i++;
+            continue;
+        }
+        // The moved particle may be dead too, so slot i is checked again.
+        kill(i);
+        liveCount--;
+        if (i != liveCount) {
+            move(liveCount, i);
+            const Page& last = pageOf(liveCount, entry);
+            last.columns.lifetime[entry] = 0.0f;
+            last.handle[entry] = NO_HANDLE;
+        }
+    }
+}
+
+void ParticlePool::clear() {
+    for (int slot = 0; slot < liveCount; ++slot) {
+        kill(slot);
+    }
+    liveCount = 0;
+}
+
+// All columns of a page are four bytes wide and sit back to back in its
+// block, handle last, so they are moved as raw words.
+void ParticlePool::reorder(const int* order, JobSystem* jobs) {
+    size_t live = static_cast<size_t>(liveCount);
+    reorderScratch.resize(PAGE_COLUMNS * live);
+    uint32_t* scratch = reorderScratch.data();
+    auto gather = [&](int begin, int end, int) {
+        for (int slot = begin; slot < end; ++slot) {
+            int source = order[slot];
+            const char* word = static_cast<const char*>(pages[source >> PARTICLE_PAGE_SHIFT].block) + (source & (PARTICLE_PAGE_SIZE - 1)) * sizeof(uint32_t);
+            for (int c = 0; c < PAGE_COLUMNS; ++c) {
+                std::memcpy(&scratch[c * live + slot], word + c * PARTICLE_PAGE_SIZE * sizeof(uint32_t), sizeof(uint32_t));
+            }
+        }
+    };
+    auto scatter = [&](int begin, int end, int) {
+        for (int page = begin; page < end; ++page) {
+            char* block = static_cast<char*>(pages[page].block);
+            int first = page << PARTICLE_PAGE_SHIFT;
+            int count = std::min(liveCount - first, PARTICLE_PAGE_SIZE);
+            for (int c = 0; c < PAGE_COLUMNS; ++c) {
+                std::memcpy(block + c * PARTICLE_PAGE_SIZE * sizeof(uint32_t), &scratch[c * live + first], count * sizeof(uint32_t));
+            }
+            const uint32_t* handle = pages[page].handle;
+            for (int entry = 0; entry < count; ++entry) {
+                if (handle[entry] != NO_HANDLE) handles[handle[entry]].slot = first + entry;
+            }
+        }
+    };
+    if (jobs) {
+        jobs->parallelFor(liveCount, PARTICLE_PAGE_SIZE, gather);
+        jobs->parallelFor(getLivePageCount(), 1, scatter);
+    }
+    else {
+        gather(0, liveCount, 0);
+        scatter(0, getLivePageCount(), 0);
+    }
+}
+
+int ParticlePool::compactRange(int begin, int end) {
+    const Page& page = pages[begin >> PARTICLE_PAGE_SHIFT];
+    const ParticleColumns& c = page.columns;
+    int base = begin & ~(PARTICLE_PAGE_SIZE - 1);
+    int first = begin - base;
+    int last = std::min(end, liveCount) - base;
+    int i = first;
+    while (i < last) {
+        // Most of a range survives a step; skip it a block at a time.
+        if (i + PARTICLE_SIMD_WIDTH <= last) {
+            float lowest = c.lifetime[i];
+            for (int k = 1; k < PARTICLE_SIMD_WIDTH; ++k) lowest = std::min(lowest, c.lifetime[i + k]);
+            if (lowest > 0.0f) {
+                i += PARTICLE_SIMD_WIDTH;
+                continue;
+            }
+        }
+        if (c.lifetime[i] > 0.0f) {
+            i++;
+            continue;
+        }
+        // Every handle belongs to one particle, so ranges compacted in
+        // parallel never touch the same entry; only the free list is
+        // shared, and that waits for closeRangeGaps.
+        uint32_t index = page.handle[i];
+        if (index != NO_HANDLE) {
+            handles[index].generation++;
+            handles[index].slot = -1;
+            retiredHandles[begin >> PARTICLE_PAGE_SHIFT].push_back(index);
+            page.handle[i] = NO_HANDLE;
+        }
+        // The moved particle may be dead too, so entry i is checked again.
+        last--;
+        if (i != last) {
+            move(base + last, base + i);
+            page.handle[last] = NO_HANDLE;
+        }
+    }
+    return i - first;
+}
+
+void ParticlePool::closeRangeGaps(const int* kept, int rangeSize, const std::function<void(int, int)>& moved) {
+    for (int page = 0; page < getLivePageCount(); ++page) {
+        freeHandles.insert(freeHandles.end(), retiredHandles[page].begin(), retiredHandles[page].end());
+        retiredHandles[page].clear();
+    }
+    int ranges = (liveCount + rangeSize - 1) / rangeSize;
+    if (ranges == 0) return;
+    int total = 0;
+    for (int r = 0; r < ranges; ++r) total += kept[r];
+
+    // Holes below total, front to back, are filled with the live particles
+    // at or past it, back to front; there are as many of each.
+    int holeRange = 0, hole = kept[0];
+    int liveRange = ranges - 1, live = liveRange * rangeSize + kept[liveRange] - 1;
+    while (true) {
+        while (holeRange < ranges && hole >= std::min((holeRange + 1) * rangeSize, liveCount)) {
+            holeRange++;
+            hole = holeRange < ranges ? holeRange * rangeSize + kept[holeRange] : liveCount;
+        }
+        if (holeRange >= ranges || hole >= total) break;
+        while (live < liveRange * rangeSize) {
+            liveRange--;
+            live = liveRange * rangeSize + kept[liveRange] - 1;
+        }
+        move(live, hole);
+        moved(live, hole);
+        hole++;
+        live--;
+    }
+
+    for (int slot = total; slot < liveCount; ++slot) {
+        int entry;
+        const Page& page = pageOf(slot, entry);
+        page.columns.lifetime[entry] = 0.0f;
+        page.handle[entry] = NO_HANDLE;
+    }
+    liveCount = total;
+}
+
+ParticleHandle ParticlePool::getHandle(int slot) {
+    int entry;
+    const Page& page = pageOf(slot, entry);
+    uint32_t index = page.handle[entry];
+    if (index == NO_HANDLE) {
+        if (freeHandles.empty()) {
+            index = static_cast<uint32_t>(handles.size());
+            handles.push_back({ -1, 0 });
+        }
+        else {
+            index = freeHandles.back();
+            freeHandles.pop_back();
+        }
+        handles[index].slot = slot;
+        page.handle[entry] = index;
+    }
+    ParticleHandle handle;
+    handle.index = index;
+    handle.generation = handles[index].generation;
+    return handle;
+}
+
+int ParticlePool::resolve(ParticleHandle handle) const {
+    if (handle.index >= handles.size()) return -1;
+    const HandleEntry& entry = handles[handle.index];
+    return entry.generation == handle.generation ? entry.slot : -1;
+}
+
+void ParticlePool::move(int from, int to) {
+    int source, target;
+    const Page& sourcePage = pageOf(from, source);
+    const Page& targetPage = pageOf(to, target);
+    const ParticleColumns& s = sourcePage.columns;
+    const ParticleColumns& t = targetPage.columns;
+    t.x[target] = s.x[source];
+    t.y[target] = s.y[source];
+    t.prevX[target] = s.prevX[source];
+    t.prevY[target] = s.prevY[source];
+    t.vx[target] = s.vx[source];
+    t.vy[target] = s.vy[source];
+    t.lifetime[target] = s.lifetime[source];
+    t.color[target] = s.color[source];
+
+    uint32_t index = sourcePage.handle[source];
+    targetPage.handle[target] = index;
+    if (index != NO_HANDLE) handles[index].slot = to;
+}
+
+// Zeroes the lifetime of slot and retires its handle, if it has one.
+void ParticlePool::kill(int slot) {
+    int entry;
+    const Page& page = pageOf(slot, entry);
+    page.columns.lifetime[entry] = 0.0f;
+    uint32_t index = page.handle[entry];
+    if (index == NO_HANDLE) return;
+    handles[index].generation++;
+    handles[index].slot = -1;
+    freeHandles.push_back(index);
+    page.handle[entry] = NO_HANDLE;
+}
@@ -0,0 +1,145 @@
+#ifndef PARTICLE_POOL_H
+#define PARTICLE_POOL_H
+
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <vector>
+#include "job_system.h"
+
+#if defined(_MSC_VER)
+#define PARTICLE_RESTRICT __restrict
+#else
+#define PARTICLE_RESTRICT __restrict__
+#endif
+
+// Columns are padded to a whole number of AVX2 float lanes and aligned to a
+// cache line so the kernels never need a scalar tail or an unaligned load.
+const int PARTICLE_SIMD_WIDTH = 8;
+const size_t PARTICLE_ALIGNMENT = 64;
+
+// Particles per page. A power of two, so slot / page and slot % page are
+// shifts, and a multiple of PARTICLE_SIMD_WIDTH.
+const int PARTICLE_PAGE_SHIFT = 14;
+const int PARTICLE_PAGE_SIZE = 1 << PARTICLE_PAGE_SHIFT;
+
+// Raw view over particles handed to the update kernels. count is rounded
+// up to PARTICLE_SIMD_WIDTH; the extra slots are dead (lifetime 0). color
+// is RGBA8 as packed by glm::packUnorm4x8, red in the lowest byte.
+struct ParticleColumns {
+    float* x;
+    float* y;
+    float* prevX;
+    float* prevY;
+    float* vx;
+    float* vy;
+    float* lifetime;
+    uint32_t* color;
+    int count;
+
+    // View of [begin, end); begin should be a multiple of PARTICLE_SIMD_WIDTH
+    // to keep the slice aligned.
+    ParticleColumns slice(int begin, int end) const {
+        return { x + begin, y + begin, prevX + begin, prevY + begin, vx + begin, vy + begin, lifetime + begin, color + begin, end - begin };
+    }
+};
+
+// Reference to one particle that survives compaction. Resolves to -1 once
+// the particle has died, even if its slot has been reused since.
+struct ParticleHandle {
+    uint32_t index = 0xffffffffu;
+    uint32_t generation = 0;
+};
+
+// Structure-of-arrays particle storage in fixed pages of PARTICLE_PAGE_SIZE
+// particles, each page one aligned allocation holding all of its columns.
+// Growing adds pages and shrinking frees trailing ones, so live particles
+// never move and column pointers stay valid across resize().
+//
+// Live particles are kept packed in slots [0, liveCount), slot s being
+// entry s % PARTICLE_PAGE_SIZE of page s / PARTICLE_PAGE_SIZE. Spawning
+// appends, compact() fills the holes left by dead particles by moving the
+// last live one down. Every slot past liveCount has a lifetime of 0.
+// prevX/prevY hold the position before the last step so the renderer can
+// interpolate between steps.
+class ParticlePool {
+public:
+    ParticlePool(int capacity = 0);
+    ~ParticlePool();
+    ParticlePool(const ParticlePool&) = delete;
+    ParticlePool& operator=(const ParticlePool&) = delete;
+
+    void resize(int capacity);
+    int getCapacity() const { return capacity; }
+    int getLiveCount() const { return liveCount; }
+
+    int getPageCount() const { return static_cast<int>(pages.size()); }
+    // Pages holding at least one live particle; always the leading ones.
+    int getLivePageCount() const { return (liveCount + PARTICLE_PAGE_SIZE - 1) >> PARTICLE_PAGE_SHIFT; }
+    // Columns of a page; count covers its live particles rounded up to
+    // PARTICLE_SIMD_WIDTH.
+    ParticleColumns getPage(int page) const;
+
+    // Claims up to count slots at the end of the live range and returns how
+    // many were granted. The new slots start at getLiveCount() - granted.
+    int allocate(int count);
+    // Removes dead particles from [first, liveCount).
+    void compact(int first = 0);
+    void clear();
+    // Permutes the live particles: slot s takes the particle from slot
+    // order[s]. order must be a permutation of [0, getLiveCount()). Handles
+    // follow their particles.
+    void reorder(const int* order, JobSystem* jobs = nullptr);
+
+    // Compaction in two halves, for passes that retire particles while
+    // they still have them in cache. compactRange packs the live particles
+    // among slots [begin, end), which must lie in one page, to its front,
+    // moving as few as compact() does, and returns how many there are;
+    // ranges on different pages may be compacted in parallel. Once every range of rangeSize slots has
+    // been, closeRangeGaps takes kept[range], fills the holes behind them
+    // with particles from the back and calls moved(from, to) for each of
+    // those. rangeSize must divide PARTICLE_PAGE_SIZE.
+    int compactRange(int begin, int end);
+    void closeRangeGaps(const int* kept, int rangeSize, const std::function<void(int, int)>& moved);
+
+    // Handle for the live particle in slot; repeated calls return the same
+    // handle for as long as the particle lives.
+    ParticleHandle getHandle(int slot);
+    // Current slot of the particle, or -1 once it has died.
+    int resolve(ParticleHandle handle) const;
+
+private:
+    // The handle column is not part of ParticleColumns; the kernels never
+    // need it. Slots without a handle hold NO_HANDLE.
+    struct Page {
+        ParticleColumns columns;
+        uint32_t* handle;
+        void* block;
+    };
+
+    struct HandleEntry {
+        int slot;
+        uint32_t generation;
+    };
+
+    static Page allocatePage();
+    static void freePage(Page& page);
+    const Page& pageOf(int slot, int& entry) const {
+        entry = slot & (PARTICLE_PAGE_SIZE - 1);
+        return pages[slot >> PARTICLE_PAGE_SHIFT];
+    }
+    void move(int from, int to);
+    void kill(int slot);
+
+    std::vector<Page> pages;
+    std::vector<HandleEntry> handles;
+    std::vector<uint32_t> freeHandles;
+    std::vector<uint32_t> reorderScratch;
+    // Handles retired by compactRange, per page, until closeRangeGaps
+    // frees them.
+    std::vector<std::vector<uint32_t>> retiredHandles;
+    int capacity;
+    int liveCount;
+};
+
+#endif // !PARTICLE_POOL_H
@@ -0,0 +1,536 @@
+#include "particle_system.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include "collision_kernels.h"
+#include "config.h"
+#include "particle_kernels.h"
+
+// Draws getRandomValidPosition makes before giving up.
+static const int RANDOM_POSITION_ATTEMPTS = 100;
+
+// Samples per spacing-sized square the Poisson-disk sampler leaves in open
+// space, about; placeObstacles picks its first spacing by it.
+static const float PLACEMENT_DENSITY = 0.55f;
+
+// Factor placeObstacles shrinks the sample spacing by when too few fit.
+static const float PLACEMENT_TIGHTENING = 0.85f;
+
+// Share of the normal speed fluid keeps when it hits the bounds.
+static const float FLUID_WALL_BOUNCE = 0.3f;
+
+// Particles per tile of the tiled update. All of their columns plus their
+// vertices come to about 100 KB, which stays in L2 from the step through
+// packing.
+static const int UPDATE_TILE_SIZE = 2048;
+
+ParticleSystem::ParticleSystem(int maxParticles) : pool(maxParticles), updatesSinceReorder(0), jobs(nullptr), seed(0) {
+    reset();
+}
+
+void ParticleSystem::setJobSystem(JobSystem* jobSystem) {
+    jobs = jobSystem;
+}
+
+void ParticleSystem::setSeed(uint64_t newSeed) {
+    seed = newSeed;
+    random.reseed(seed);
+    for (size_t i = 0; i < emitters.size(); ++i) {
+        emitters[i].random.reseed(seed, i + 1);
+    }
+}
+
+void ParticleSystem::update(float deltaTime, bool forceActive, bool attract, glm::vec2 cursorPos) {
+    update(deltaTime, forceActive, attract, cursorPos, nullptr, 0.0f);
+}
+
+void ParticleSystem::update(float deltaTime, bool forceActive, bool attract, glm::vec2 cursorPos, std::vector<ParticleVertex>* vertices, float alpha) {
+    int substeps = settings.fluid.enabled ? std::max(settings.fluid.substeps, 1) : 1;
+    fluidTimings = FluidTimings();
+    if (settings.obstacleField.enabled) {
+        obstacleField.sync(obstacles, polygonShapes, obstacleTree, colliderOwners, settings.obstacleField, jobs);
+    }
+    bool tiled = settings.tiledUpdate && substeps == 1 && !settings.gravity.enabled && !settings.collisions.enabled;
+    if (tiled) {
+        advanceTiled(deltaTime, forceActive, attract, cursorPos, vertices, alpha);
+    }
+    else if (substeps == 1) {
+        advance(deltaTime, forceActive, attract, cursorPos);
+    }
+    else {
+        // Every substep moves prevX/prevY along, but the renderer
+        // interpolates across the whole update, so the positions from
+        // before the first one are put back afterwards.
+        int live = pool.getLiveCount();
+        startX.resize(live);
+        startY.resize(live);
+        for (int page = 0; page < pool.getLivePageCount(); ++page) {
+            ParticleColumns p = pool.getPage(page);
+            int offset = page * PARTICLE_PAGE_SIZE;
+            int count = std::min(live - offset, PARTICLE_PAGE_SIZE);
+            std::copy(p.x, p.x + count, startX.begin() + offset);
+            std::copy(p.y, p.y + count, startY.begin() + offset);
+        }
+        for (int step = 0; step < substeps; ++step) {
+            advance(deltaTime / substeps, forceActive, attract, cursorPos);
+        }
+        for (int page = 0; page < pool.getLivePageCount(); ++page) {
+            ParticleColumns p = pool.getPage(page);
+            int offset = page * PARTICLE_PAGE_SIZE;
+            int count = std::min(live - offset, PARTICLE_PAGE_SIZE);
+            std::copy(startX.begin() + offset, startX.begin() + offset + count, p.prevX);
+            std::copy(startY.begin() + offset, startY.begin() + offset + count, p.prevY);
+        }
+    }
+
+    // Compaction and spawning reorder the pool, so they stay serial.
+    if (!tiled) pool.compact();
+    int spawned = pool.getLiveCount();
+    emitParticles(emitters, pool, deltaTime, jobs);
+
+    bool reordered = false;
+    if (settings.reorder.interval > 0 && ++updatesSinceReorder >= settings.reorder.interval) {
+        mortonSorter.sort(pool, settings.reorder.cellSize, jobs);
+        updatesSinceReorder = 0;
+        reordered = true;
+    }
+
+    // The tiled step has packed everything but the new particles.
+    if (!vertices) return;
+    if (!tiled || reordered) {
+        writeVertices(alpha, *vertices);
+        return;
+    }
+    vertices->resize(pool.getLiveCount());
+    for (int slot = spawned; slot < pool.getLiveCount(); slot += PARTICLE_PAGE_SIZE - (slot & (PARTICLE_PAGE_SIZE - 1))) {
+        int entry = slot & (PARTICLE_PAGE_SIZE - 1);
+        int count = std::min(pool.getLiveCount() - slot, PARTICLE_PAGE_SIZE - entry);
+        ParticleColumns columns = pool.getPage(slot >> PARTICLE_PAGE_SHIFT);
+        packVertices(columns.slice(entry, entry + count), count, alpha, vertices->data() + slot);
+    }
+}
+
+// The mode is picked once per step; the kernel for it has no per-particle
+// tests of these flags.
+UpdateKernel ParticleSystem::prepareUpdate(float deltaTime, bool force, bool attract, glm::vec2 cursorPos, bool obstacles, UpdateParams& params) const {
+    bool field = settings.obstacleField.enabled;
+    unsigned mode = obstacles && !field ? getObstacleTypeMask(colliders) : 0;
+    if (obstacles && field && colliders.getTotalCount() > 0) mode |= UPDATE_FIELD;
+    if (force) mode |= UPDATE_FORCE;
+    if (attract) mode |= UPDATE_ATTRACT;
+    if (settings.fluid.enabled) mode |= UPDATE_BOUNDS;
+    params.deltaTime = deltaTime;
+    params.forcePoint = cursorPos;
+    params.forceStrength = settings.velocity;
+    params.boundsMin = settings.fluid.boundsMin;
+    params.boundsMax = settings.fluid.boundsMax;
+    params.bounce = FLUID_WALL_BOUNCE;
+    params.colliders = &colliders;
+    params.tree = &obstacleTree;
+    params.field = obstacleField.getView();
+    return getUpdateKernel(mode);
+}
+
+void ParticleSystem::advance(float deltaTime, bool forceActive, bool attract, glm::vec2 cursorPos) {
+    float strength = attract ? settings.velocity : -settings.velocity;
+    bool gravity = settings.gravity.enabled;
+    bool meshGravity = settings.gravity.solver == GRAVITY_PARTICLE_MESH;
+    if (gravity && meshGravity) {
+        gravityMesh.solve(pool, settings.gravity.meshSize, settings.gravity.softening, jobs);
+    }
+    else if (gravity) {
+        gravityTree.build(pool, jobs);
+    }
+    bool fluid = settings.fluid.enabled;
+    if (fluid) {
+        fluidSolver.step(pool, settings.fluid, deltaTime, jobs, fluidTimings);
+    }
+
+    // Particle collisions need every particle moved before any pair is
+    // resolved, and obstacles get the last word, so they split the pass.
+    bool collide = settings.collisions.enabled;
+
+    // Gravity has to land between the point force and the move, so with it
+    // on the force runs as a pass of its own.
+    UpdateParams params;
+    UpdateKernel kernel = prepareUpdate(deltaTime, forceActive && !gravity, attract, cursorPos, !collide, params);
+
+    // Every particle only reads and writes its own slot here, so pages can
+    // run in any order on any thread.
+    auto step = [&](int begin, int end, int) {
+        for (int page = begin; page < end; ++page) {
+            ParticleColumns columns = pool.getPage(page);
+            if (gravity && forceActive) {
+                applyPointForce(columns, cursorPos, strength, deltaTime);
+            }
+            if (gravity && meshGravity) {
+                applyMeshGravity(columns, gravityMesh, settings.gravity, deltaTime);
+            }
+            else if (gravity) {
+                applyGravity(columns, gravityTree, settings.gravity, deltaTime);
+            }
+            kernel(columns, params);
+        }
+    };
+    auto obstacleStep = [&](int begin, int end, int) {
+        for (int page = begin; page < end; ++page) {
+            if (settings.obstacleField.enabled) {
+                collideObstacleField(pool.getPage(page), obstacleField);
+            }
+            else {
+                collideObstacles(pool.getPage(page), colliders, &obstacleTree);
+            }
+        }
+    };
+    int pages = pool.getLivePageCount();
+    auto start = std::chrono::steady_clock::now();
+    if (jobs) {
+        jobs->parallelFor(pages, 1, step);
+    }
+    else {
+        step(0, pages, 0);
+    }
+    if (fluid) {
+        fluidTimings.integrate += std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    }
+    if (collide) {
+        collideParticles(pool, particleHash, settings.collisions, jobs);
+        if (jobs) {
+            jobs->parallelFor(pages, 1, obstacleStep);
+        }
+        else {
+            obstacleStep(0, pages, 0);
+        }
+    }
+}
+
+// Without the global passes every particle's step is independent, so each
+// tile goes through the whole step, compaction and vertex packing while it
+// is still in cache. Tiles compact into their own front, pages in
+// parallel; closing the gaps between them afterwards only moves about as
+// many particles as died.
+void ParticleSystem::advanceTiled(float deltaTime, bool forceActive, bool attract, glm::vec2 cursorPos, std::vector<ParticleVertex>* vertices, float alpha) {
+    UpdateParams params;
+    UpdateKernel kernel = prepareUpdate(deltaTime, forceActive, attract, cursorPos, true, params);
+    int live = pool.getLiveCount();
+    keptPerTile.resize((live + UPDATE_TILE_SIZE - 1) / UPDATE_TILE_SIZE);
+    if (vertices) vertices->resize(live);
+    ParticleVertex* out = vertices ? vertices->data() : nullptr;
+
+    auto step = [&](int begin, int end, int) {
+        for (int page = begin; page < end; ++page) {
+            ParticleColumns columns = pool.getPage(page);
+            int base = page << PARTICLE_PAGE_SHIFT;
+            for (int tile = 0; tile < columns.count; tile += UPDATE_TILE_SIZE) {
+                int tileEnd = std::min(tile + UPDATE_TILE_SIZE, columns.count);
+                kernel(columns.slice(tile, tileEnd), params);
+                int kept = pool.compactRange(base + tile, base + tileEnd);
+                if (out) {
+                    packVertices(columns.slice(tile, tile + kept), kept, alpha, out + base + tile);
+                }
+                keptPerTile[(base + tile) / UPDATE_TILE_SIZE] = kept;
+            }
+        }
+    };
+    if (jobs) {
+        jobs->parallelFor(pool.getLivePageCount(), 1, step);
+    }
+    else {
+        step(0, pool.getLivePageCount(), 0);
+    }
+    pool.closeRangeGaps(keptPerTile.data(), UPDATE_TILE_SIZE, [&](int from, int to) {
+        if (out) out[to] = out[from];
+    });
+}
+
+void ParticleSystem::writeVertices(float alpha, std::vector<ParticleVertex>& vertices) const {
+    vertices.resize(pool.getLiveCount());
+    auto pack = [&](int begin, int end, int) {
+        for (int page = begin; page < end; ++page) {
+            int base = page << PARTICLE_PAGE_SHIFT;
+            int live = std::min(pool.getLiveCount() - base, PARTICLE_PAGE_SIZE);
+            packVertices(pool.getPage(page), live, alpha, vertices.data() + base);
+        }
+    };
+    if (jobs) {
+        jobs->parallelFor(pool.getLivePageCount(), 1, pack);
+    }
+    else {
+        pack(0, pool.getLivePageCount(), 0);
+    }
+}
+
+void ParticleSystem::resize(int maxParticles) {
+    pool.resize(maxParticles);
+}
+
+void ParticleSystem::reset() {
+    pool.clear();
+}
+
+int ParticleSystem::addEmitter(const Emitter& emitter) {
+    emitters.push_back(emitter);
+    emitters.back().random.reseed(seed, emitters.size());
+    return static_cast<int>(emitters.size()) - 1;
+}
+
+Emitter& ParticleSystem::getEmitter(int index) {
+    return emitters[index];
+}
+
+std::vector<Emitter>& ParticleSystem::getEmitters() {
+    return emitters;
+}
+
+void ParticleSystem::clearEmitters() {
+    emitters.clear();
+}
+
+int ParticleSystem::addPolygonShape(const std::vector<glm::vec2>& vertices) {
+    PolygonShape shape;
+    if (!makePolygonShape(vertices, shape)) return -1;
+    polygonShapes.push_back(shape);
+    return static_cast<int>(polygonShapes.size()) - 1;
+}
+
+int ParticleSystem::addPolygonShape(const PolygonShape& shape) {
+    polygonShapes.push_back(shape);
+    return static_cast<int>(polygonShapes.size()) - 1;
+}
+
+const PolygonShape& ParticleSystem::getPolygonShape(int shape) const {
+    return polygonShapes[shape];
+}
+
+int ParticleSystem::getPolygonShapeCount() const {
+    return static_cast<int>(polygonShapes.size());
+}
+
+void ParticleSystem::clearPolygonShapes() {
+    clearObstacles();
+    polygonShapes.clear();
+}
+
+glm::vec2 ParticleSystem::getHalfExtent(const Obstacle& obstacle) const {
+    if (obstacle.type == OBSTACLE_POLYGON) return polygonShapes[obstacle.shape].halfExtent * obstacle.size;
+    return glm::vec2(obstacle.size / 2);
+}
+
+const PolygonShape* ParticleSystem::getShapeOf(const Obstacle& obstacle) const {
+    return obstacle.type == OBSTACLE_POLYGON ? &polygonShapes[obstacle.shape] : nullptr;
+}
+
+bool ParticleSystem::appendObstacle(const Obstacle& obstacle, ObstacleTree::Leaf& leaf) {
+    int type = obstacle.type;
+    if (type < 0 || type >= OBSTACLE_TYPE_COUNT) return false;
+    bool polygon = type == OBSTACLE_POLYGON;
+    if (polygon && (obstacle.shape < 0 || obstacle.shape >= static_cast<int>(polygonShapes.size()))) return false;
+    int index = static_cast<int>(obstacles.size());
+    obstacles.push_back(obstacle);
+    if (!polygon) obstacles.back().shape = -1;
+    int collider = colliders.add(obstacles.back(), getShapeOf(obstacles.back()));
+    colliderOwners[type].push_back(index);
+    glm::vec2 half = getHalfExtent(obstacle);
+    leaf = { obstacle.position - half, obstacle.position + half, type, collider };
+    obstacleColliders.push_back(collider);
+    obstacleField.invalidate(leaf.minBound, leaf.maxBound);
+    return true;
+}
+
+int ParticleSystem::addObstacle(glm::vec2 position, float size, int type, int shape) {
+    Obstacle obstacle = { position, size, type, shape };
+    ObstacleTree::Leaf leaf;
+    if (!appendObstacle(obstacle, leaf)) return -1;
+    obstacleProxies.push_back(obstacleTree.insert(leaf.minBound, leaf.maxBound, leaf.type, leaf.index));
+    return static_cast<int>(obstacles.size()) - 1;
+}
+
+int ParticleSystem::addObstacles(const Obstacle* batch, int count) {
+    std::vector<ObstacleTree::Leaf> leaves;
+    leaves.reserve(count);
+    obstacles.reserve(obstacles.size() + count);
+    for (int i = 0; i < count; ++i) {
+        ObstacleTree::Leaf leaf;
+        if (appendObstacle(batch[i], leaf)) leaves.push_back(leaf);
+    }
+    obstacleTree.insert(leaves, obstacleProxies);
+    return static_cast<int>(leaves.size());
+}
+
+// Moving or resizing only touches the obstacle's own collider, its leaf
+// when it leaves the leaf's fat bounds, and the field around it.
+void ParticleSystem::setObstacle(int index, const Obstacle& obstacle) {
+    Obstacle& current = obstacles[index];
+    glm::vec2 half = getHalfExtent(current);
+    obstacleField.invalidate(current.position - half, current.position + half);
+    current = obstacle;
+    half = getHalfExtent(obstacle);
+    colliders.set(obstacleColliders[index], obstacle, getShapeOf(obstacle));
+    obstacleTree.move(obstacleProxies[index], obstacle.position - half, obstacle.position + half);
+    obstacleField.invalidate(obstacle.position - half, obstacle.position + half);
+}
+
+void ParticleSystem::moveObstacle(int index, glm::vec2 position) {
+    Obstacle obstacle = obstacles[index];
+    obstacle.position = position;
+    setObstacle(index, obstacle);
+}
+
+void ParticleSystem::resizeObstacle(int index, float size) {
+    Obstacle obstacle = obstacles[index];
+    obstacle.size = size;
+    setObstacle(index, obstacle);
+}
+
+// The colliders and the obstacle list both fill the hole with their last
+// entry, and every reference to that entry follows it.
+void ParticleSystem::removeObstacle(int index) {
+    const Obstacle& obstacle = obstacles[index];
+    int type = obstacle.type;
+    glm::vec2 half = getHalfExtent(obstacle);
+    obstacleField.invalidate(obstacle.position - half, obstacle.position + half);
+    obstacleTree.remove(obstacleProxies[index]);
+
+    int collider = obstacleColliders[index];
+    int movedOwner = colliderOwners[type].back();
+    colliders.remove(type, collider);
+    if (movedOwner != index) {
+        // Only another obstacle's collider moved; when it was this one's,
+        // its proxy is already back on the tree's free list.
+        colliderOwners[type][collider] = movedOwner;
+        obstacleColliders[movedOwner] = collider;
+        obstacleTree.setIndex(obstacleProxies[movedOwner], collider);
+    }
+    colliderOwners[type].pop_back();
+
+    int last = static_cast<int>(obstacles.size()) - 1;
+    if (index != last) {
+        obstacles[index] = obstacles[last];
+        obstacleProxies[index] = obstacleProxies[last];
+        obstacleColliders[index] = obstacleColliders[last];
+        colliderOwners[obstacles[index].type][obstacleColliders[index]] = index;
+    }
+    obstacles.pop_back();
+    obstacleProxies.pop_back();
+    obstacleColliders.pop_back();
+}
+
+void ParticleSystem::clearObstacles() {
+    obstacles.clear();
+    colliders.clear();
+    obstacleTree.clear();
+    obstacleProxies.clear();
+    obstacleColliders.clear();
+    for (std::vector<int>& owners : colliderOwners) {
+        owners.clear();
+    }
+    obstacleField.invalidateAll();
+}
+
+int ParticleSystem::findObstacle(glm::vec2 point) const {
+    int found = -1;
+    obstacleTree.query(point, point, [&](int type, int collider) {
+        int index = colliderOwners[type][collider];
+        const Obstacle& obstacle = obstacles[index];
+        float half = obstacle.size / 2;
+        bool inside;
+        if (type == OBSTACLE_SQUARE) {
+            inside = glm::all(glm::lessThan(glm::abs(point - obstacle.position), glm::vec2(half)));
+        }
+        else if (type == OBSTACLE_TRIANGLE) {
+            inside = isPointInTriangle(point, obstacle.position + glm::vec2(0, -half),
+                obstacle.position + glm::vec2(-half, half), obstacle.position + glm::vec2(half, half));
+        }
+        else if (type == OBSTACLE_CIRCLE) {
+            inside = glm::length(point - obstacle.position) < half;
+        }
+        else {
+            inside = isPointInPolygon(point, polygonShapes[obstacle.shape], obstacle.position, obstacle.size);
+        }
+        if (inside && index > found) found = index;
+    });
+    return found;
+}
+
+bool ParticleSystem::isAreaFree(glm::vec2 minBound, glm::vec2 maxBound) const {
+    bool overlap = false;
+    obstacleTree.query(minBound, maxBound, [&](int type, int collider) {
+        const Obstacle& obstacle = obstacles[colliderOwners[type][collider]];
+        glm::vec2 half = getHalfExtent(obstacle);
+        glm::vec2 low = obstacle.position - half, high = obstacle.position + half;
+        if (low.x < maxBound.x && high.x > minBound.x && low.y < maxBound.y && high.y > minBound.y) {
+            overlap = true;
+        }
+    });
+    return !overlap;
+}
+
+// Poisson-disk samples over the window at a spacing wide enough that about
+// count of them fit, tightened toward size until they do, then a random
+// count of them. Each pass costs about as much as the samples it finds.
+int ParticleSystem::placeObstacles(int count, float size, int type, int shape) {
+    if (count <= 0 || type < -1 || type >= OBSTACLE_TYPE_COUNT || !(size > 0.0f)) return 0;
+    if (type == OBSTACLE_POLYGON && (shape < 0 || shape >= static_cast<int>(polygonShapes.size()))) return 0;
+    glm::vec2 half = type == OBSTACLE_POLYGON ? polygonShapes[shape].halfExtent * size : glm::vec2(size / 2);
+    glm::vec2 minBound = half;
+    glm::vec2 maxBound = glm::vec2(SCR_WIDTH, SCR_HEIGHT) - half;
+    if (maxBound.x < minBound.x || maxBound.y < minBound.y) return 0;
+
+    auto accept = [&](glm::vec2 point) { return isAreaFree(point - half, point + half); };
+    float spacing = std::max(size, std::sqrt(PLACEMENT_DENSITY * SCR_WIDTH * SCR_HEIGHT / count));
+    for (;;) {
+        placementSampler.sample(minBound, maxBound, spacing, random, accept, placementSamples);
+        if (static_cast<int>(placementSamples.size()) >= count || spacing <= size) break;
+        spacing = std::max(size, spacing * PLACEMENT_TIGHTENING);
+    }
+
+    int available = static_cast<int>(placementSamples.size());
+    int placed = std::min(count, available);
+    for (int i = 0; i < placed; ++i) {
+        int pick = i + static_cast<int>(random.nextUInt() % (available - i));
+        std::swap(placementSamples[i], placementSamples[pick]);
+        // Without a type the square, triangle and circle take turns.
+        addObstacle(placementSamples[i], size, type < 0 ? i % OBSTACLE_POLYGON : type, shape);
+    }
+    return placed;
+}
+
+bool ParticleSystem::getRandomValidPosition(float size, glm::vec2& position) {
+    glm::vec2 half(size / 2);
+    for (int attempt = 0; attempt < RANDOM_POSITION_ATTEMPTS; ++attempt) {
+        glm::vec2 pos = linearRand(random, half, glm::vec2(SCR_WIDTH, SCR_HEIGHT) - half);
+        if (isAreaFree(pos - half, pos + half)) {
+            position = pos;
+            return true;
+        }
+    }
+    return false;
+}
+
+ParticlePool& ParticleSystem::getPool() {
+    return pool;
+}
+
+const std::vector<Obstacle>& ParticleSystem::getObstacles() const {
+    return obstacles;
+}
+
+ParticleSettings& ParticleSystem::getSettings() {
+    return settings;
+}
+
+const FluidTimings& ParticleSystem::getFluidTimings() const {
+    return fluidTimings;
+}
+
+int ParticleSystem::getLiveCount() const {
+    return pool.getLiveCount();
+}
+
+bool isPointInTriangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+    float area = 0.5f * (-b.y * c.x + a.y * (-b.x + c.x) + a.x * (b.y - c.y) + b.x * c.y);
+    float s = 1 / (2 * area) * (a.y * c.x - a.x * c.y + (c.y - a.y) * p.x + (a.x - c.x) * p.y);
+    float t = 1 / (2 * area) * (a.x * b.y - a.y * b.x + (a.y - b.y) * p.x + (b.x - a.x) * p.y);
+
+    return s >= 0 && t >= 0 && (s + t) <= 1;
+}
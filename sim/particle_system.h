@@ -0,0 +1,169 @@
+#ifndef PARTICLE_SYSTEM_H
+#define PARTICLE_SYSTEM_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "barnes_hut.h"
+#include "color_gradient.h"
+#include "emitter.h"
+#include "job_system.h"
+#include "morton_order.h"
+#include "obstacle.h"
+#include "obstacle_colliders.h"
+#include "obstacle_field.h"
+#include "obstacle_tree.h"
+#include "particle_collisions.h"
+#include "particle_mesh.h"
+#include "particle_packing.h"
+#include "particle_pool.h"
+#include "poisson_disk.h"
+#include "polygon_shape.h"
+#include "random_stream.h"
+#include "spatial_hash.h"
+#include "sph.h"
+#include "update_kernels.h"
+
+// color and colorOverLife are applied at draw time on top of each
+// particle's spawn color; age for the gradient is measured against
+// lifetime. Changing them never touches the pool.
+struct ParticleSettings {
+    float velocity = 100.0f;
+    float lifetime = 5.0f;
+    glm::vec4 color = glm::vec4(1.0f, 1.0f, 1.0f, 1.0f);
+    ColorGradient colorOverLife;
+    GravitySettings gravity;
+    ParticleCollisionSettings collisions;
+    FluidSettings fluid;
+    ReorderSettings reorder;
+    // Collides with a distance field of the obstacles instead of sweeping
+    // against each of them.
+    ObstacleFieldSettings obstacleField;
+    // Runs steps that need no global pass (no gravity, particle collisions
+    // or fluid) tile by tile; off, they go through the separate passes.
+    bool tiledUpdate = true;
+};
+
+// Window-free particle simulation. Everything the viewer used to keep in
+// globals (pool, obstacles, tunables) lives here so it can be driven headless.
+class ParticleSystem {
+public:
+    ParticleSystem(int maxParticles);
+
+    // Spreads the per-particle passes over jobs; nullptr (the default) runs
+    // them on the calling thread. Results do not depend on the thread count.
+    void setJobSystem(JobSystem* jobSystem);
+
+    // Reseeds the system's own stream and every emitter's. Emitter i draws
+    // from stream i + 1 of the seed, so a run replays exactly from it.
+    void setSeed(uint64_t seed);
+    uint64_t getSeed() const { return seed; }
+
+    // Advances live particles, then lets every emitter spawn for this step.
+    // In fluid mode the advance is split into FluidSettings::substeps.
+    void update(float deltaTime, bool forceActive, bool attract, glm::vec2 cursorPos);
+    // Same, and leaves a vertex per live particle in slot order in vertices,
+    // interpolated alpha of the way through the step. Only the last update
+    // before a frame needs to ask.
+    void update(float deltaTime, bool forceActive, bool attract, glm::vec2 cursorPos, std::vector<ParticleVertex>* vertices, float alpha);
+    // Vertices as update leaves them, for frames without an update.
+    void writeVertices(float alpha, std::vector<ParticleVertex>& vertices) const;
+    void resize(int maxParticles);
+    void reset();
+
+    // The emitter's random stream is replaced by the one for its index.
+    int addEmitter(const Emitter& emitter);
+    Emitter& getEmitter(int index);
+    std::vector<Emitter>& getEmitters();
+    void clearEmitters();
+
+    // Registers a simple polygon, given in either winding, for polygon
+    // obstacles and returns its shape index, or -1 if it is degenerate or
+    // its edges cross.
+    int addPolygonShape(const std::vector<glm::vec2>& vertices);
+    // Takes a shape as makePolygonShape leaves it, such as one read back
+    // from a scene, without checking it again.
+    int addPolygonShape(const PolygonShape& shape);
+    const PolygonShape& getPolygonShape(int shape) const;
+    int getPolygonShapeCount() const;
+    // Also removes every obstacle, since polygons refer to their shape by
+    // index.
+    void clearPolygonShapes();
+    // Returns the new obstacle's index in getObstacles(), or -1. Polygons
+    // take the index of their shape; the outline is fitted so its longer
+    // side is size.
+    int addObstacle(glm::vec2 position, float size, int type, int shape = -1);
+    // Appends the valid obstacles of batch, skipping the rest, and indexes
+    // them in one tree build; much faster than addObstacle for thousands.
+    // Returns how many were added.
+    int addObstacles(const Obstacle* batch, int count);
+    void moveObstacle(int index, glm::vec2 position);
+    void resizeObstacle(int index, float size);
+    // The last obstacle takes over index.
+    void removeObstacle(int index);
+    void clearObstacles();
+    // Index of an obstacle containing point, or -1.
+    int findObstacle(glm::vec2 point) const;
+    // Places up to count obstacles of size and type inside the window,
+    // spread evenly, none overlapping another's bounds or those of the
+    // obstacles already there; type -1 takes the square, triangle and
+    // circle in turn. Returns how many fit. Fewer than count means the free
+    // space ran out, and whatever did fit stays placed.
+    int placeObstacles(int count, float size, int type = -1, int shape = -1);
+    // Finds a random position where an obstacle of size overlaps no
+    // other's bounds. Returns false, leaving position alone, if none of a
+    // fixed number of draws is free; the caller should then skip the
+    // obstacle, as placeObstacles does.
+    bool getRandomValidPosition(float size, glm::vec2& position);
+
+    ParticlePool& getPool();
+    const std::vector<Obstacle>& getObstacles() const;
+    ParticleSettings& getSettings();
+    // Phase times of the last update; all zero unless fluid mode is on.
+    const FluidTimings& getFluidTimings() const;
+    int getLiveCount() const;
+
+private:
+    UpdateKernel prepareUpdate(float deltaTime, bool force, bool attract, glm::vec2 cursorPos, bool obstacles, UpdateParams& params) const;
+    void advance(float deltaTime, bool forceActive, bool attract, glm::vec2 cursorPos);
+    void advanceTiled(float deltaTime, bool forceActive, bool attract, glm::vec2 cursorPos, std::vector<ParticleVertex>* vertices, float alpha);
+    // All of adding an obstacle but the tree insert, which is left to the
+    // caller with leaf. False if the obstacle is invalid.
+    bool appendObstacle(const Obstacle& obstacle, ObstacleTree::Leaf& leaf);
+    void setObstacle(int index, const Obstacle& obstacle);
+    glm::vec2 getHalfExtent(const Obstacle& obstacle) const;
+    const PolygonShape* getShapeOf(const Obstacle& obstacle) const;
+    // Whether [minBound, maxBound] overlaps no obstacle's bounds; touching
+    // is fine.
+    bool isAreaFree(glm::vec2 minBound, glm::vec2 maxBound) const;
+
+    ParticlePool pool;
+    std::vector<Emitter> emitters;
+    std::vector<Obstacle> obstacles;
+    std::vector<PolygonShape> polygonShapes;
+    ObstacleColliders colliders;
+    ObstacleTree obstacleTree;
+    ObstacleField obstacleField;
+    // Per obstacle, its leaf in obstacleTree and its index among the
+    // colliders of its type; per type, the obstacle owning each collider.
+    std::vector<int> obstacleProxies, obstacleColliders;
+    std::vector<int> colliderOwners[OBSTACLE_TYPE_COUNT];
+    PoissonDiskSampler placementSampler;
+    std::vector<glm::vec2> placementSamples;
+    BarnesHutTree gravityTree;
+    ParticleMeshSolver gravityMesh;
+    SpatialHash particleHash;
+    FluidSolver fluidSolver;
+    MortonSorter mortonSorter;
+    int updatesSinceReorder;
+    FluidTimings fluidTimings;
+    std::vector<float> startX, startY;
+    std::vector<int> keptPerTile;
+    ParticleSettings settings;
+    JobSystem* jobs;
+    uint64_t seed;
+    RandomStream random;
+};
+
+bool isPointInTriangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c);
+
+#endif // !PARTICLE_SYSTEM_H
@@ -0,0 +1,74 @@
+#include "poisson_disk.h"
+#include <cmath>
+
+// Draws around an active sample before it is retired.
+static const int CANDIDATE_ATTEMPTS = 12;
+
+// Draws inside an empty cell during the seeding sweep.
+static const int SEED_ATTEMPTS = 4;
+
+bool PoissonDiskSampler::tryAdd(glm::vec2 point, const std::function<bool(glm::vec2)>& accept, std::vector<glm::vec2>& samples) {
+    int column = glm::clamp(static_cast<int>((point.x - origin.x) / spacing), 0, columns - 1);
+    int row = glm::clamp(static_cast<int>((point.y - origin.y) / spacing), 0, rows - 1);
+    // Anything closer than spacing lies in one of the eight neighbors.
+    for (int y = glm::max(row - 1, 0); y <= glm::min(row + 1, rows - 1); ++y) {
+        for (int x = glm::max(column - 1, 0); x <= glm::min(column + 1, columns - 1); ++x) {
+            int other = grid[y * columns + x];
+            if (other < 0) continue;
+            glm::vec2 offset = glm::abs(samples[other] - point);
+            if (offset.x < spacing && offset.y < spacing) return false;
+        }
+    }
+    if (!accept(point)) return false;
+
+    int index = static_cast<int>(samples.size());
+    samples.push_back(point);
+    grid[row * columns + column] = index;
+    active.push_back(index);
+    return true;
+}
+
+void PoissonDiskSampler::sample(glm::vec2 minBound, glm::vec2 maxBound, float spacing, RandomStream& random,
+    const std::function<bool(glm::vec2)>& accept, std::vector<glm::vec2>& samples) {
+    samples.clear();
+    glm::vec2 extent = maxBound - minBound;
+    if (!(spacing > 0.0f) || extent.x < 0.0f || extent.y < 0.0f) return;
+
+    this->spacing = spacing;
+    origin = minBound;
+    columns = static_cast<int>(extent.x / spacing) + 1;
+    rows = static_cast<int>(extent.y / spacing) + 1;
+    grid.assign(static_cast<size_t>(columns) * rows, -1);
+    active.clear();
+
+    for (int cell = 0; cell < columns * rows; ++cell) {
+        if (grid[cell] >= 0) continue;
+        glm::vec2 cellMin = origin + spacing * glm::vec2(cell % columns, cell / columns);
+        glm::vec2 cellMax = glm::min(cellMin + glm::vec2(spacing), maxBound);
+        bool seeded = false;
+        for (int attempt = 0; attempt < SEED_ATTEMPTS && !seeded; ++attempt) {
+            seeded = tryAdd(linearRand(random, cellMin, cellMax), accept, samples);
+        }
+
+        // Grow from the seed: candidates come from the square ring between
+        // spacing and twice spacing around a random active sample.
+        while (!active.empty()) {
+            int slot = static_cast<int>(random.nextUInt() % active.size());
+            glm::vec2 center = samples[active[slot]];
+            bool added = false;
+            for (int attempt = 0; attempt < CANDIDATE_ATTEMPTS && !added; ++attempt) {
+                glm::vec2 offset;
+                do {
+                    offset = linearRand(random, glm::vec2(-2.0f * spacing), glm::vec2(2.0f * spacing));
+                } while (glm::max(std::abs(offset.x), std::abs(offset.y)) < spacing);
+                glm::vec2 point = center + offset;
+                if (point.x < minBound.x || point.y < minBound.y || point.x > maxBound.x || point.y > maxBound.y) continue;
+                added = tryAdd(point, accept, samples);
+            }
+            if (!added) {
+                active[slot] = active.back();
+                active.pop_back();
+            }
+        }
+    }
+}
@@ -0,0 +1,34 @@
+#ifndef POISSON_DISK_H
+#define POISSON_DISK_H
+
+#include <functional>
+#include <vector>
+#include <glm/glm.hpp>
+#include "random_stream.h"
+
+// Bridson's Poisson-disk sampling, with distance measured as
+// max(|dx|, |dy|): samples at least spacing apart are the centers of boxes
+// of side spacing that do not overlap. New samples are drawn around active
+// ones until each has failed a fixed number of times; a sweep over the
+// background grid then seeds every empty cell the flood did not reach, so
+// regions walled off by rejected space are filled too. Time is linear in
+// the number of cells.
+class PoissonDiskSampler {
+public:
+    // Fills samples with points in [minBound, maxBound]. accept(point) may
+    // veto points, for example ones that would overlap existing obstacles.
+    void sample(glm::vec2 minBound, glm::vec2 maxBound, float spacing, RandomStream& random,
+        const std::function<bool(glm::vec2)>& accept, std::vector<glm::vec2>& samples);
+
+private:
+    bool tryAdd(glm::vec2 point, const std::function<bool(glm::vec2)>& accept, std::vector<glm::vec2>& samples);
+
+    glm::vec2 origin;
+    float spacing;
+    int columns, rows;
+    // Sample in each cell of side spacing, or -1; a cell holds at most one.
+    std::vector<int> grid;
+    std::vector<int> active;
+};
+
+#endif // !POISSON_DISK_H
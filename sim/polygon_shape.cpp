@@ -0,0 +1,165 @@
+#include "polygon_shape.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <numeric>
+
+// Corners whose edges turn by less than this, relative to the edge lengths,
+// count as collinear.
+static const float COLLINEAR_TOLERANCE = 1e-6f;
+
+static float cross(glm::vec2 a, glm::vec2 b) {
+    return a.x * b.y - a.y * b.x;
+}
+
+static float signedArea(const std::vector<glm::vec2>& points) {
+    float area = 0.0f;
+    for (size_t i = 0, j = points.size() - 1; i < points.size(); j = i++) {
+        area += cross(points[j], points[i]);
+    }
+    return area * 0.5f;
+}
+
+static bool isOnSegment(glm::vec2 p, glm::vec2 a, glm::vec2 b) {
+    return p.x >= std::min(a.x, b.x) && p.x <= std::max(a.x, b.x) && p.y >= std::min(a.y, b.y) && p.y <= std::max(a.y, b.y);
+}
+
+// Whether segments ab and cd share any point, touching included.
+static bool segmentsIntersect(glm::vec2 a, glm::vec2 b, glm::vec2 c, glm::vec2 d) {
+    float d1 = cross(b - a, c - a), d2 = cross(b - a, d - a);
+    float d3 = cross(d - c, a - c), d4 = cross(d - c, b - c);
+    if (((d1 > 0.0f && d2 < 0.0f) || (d1 < 0.0f && d2 > 0.0f)) && ((d3 > 0.0f && d4 < 0.0f) || (d3 < 0.0f && d4 > 0.0f))) {
+        return true;
+    }
+    return (d1 == 0.0f && isOnSegment(c, a, b)) || (d2 == 0.0f && isOnSegment(d, a, b)) ||
+        (d3 == 0.0f && isOnSegment(a, c, d)) || (d4 == 0.0f && isOnSegment(b, c, d));
+}
+
+// Closed triangle test for a triangle with positive signed area.
+static bool isInTriangle(glm::vec2 p, glm::vec2 a, glm::vec2 b, glm::vec2 c) {
+    return cross(b - a, p - a) >= 0.0f && cross(c - b, p - b) >= 0.0f && cross(a - c, p - c) >= 0.0f;
+}
+
+bool makePolygonShape(const std::vector<glm::vec2>& vertices, PolygonShape& shape) {
+    std::vector<glm::vec2> points;
+    for (glm::vec2 v : vertices) {
+        if (points.empty() || v != points.back()) points.push_back(v);
+    }
+    while (points.size() > 1 && points.front() == points.back()) points.pop_back();
+
+    // Dropping a corner can make its neighbors collinear, so go round until
+    // nothing changes.
+    for (bool removed = true; removed && points.size() >= 3;) {
+        removed = false;
+        for (size_t i = 0; i < points.size() && points.size() >= 3; ++i) {
+            glm::vec2 prev = points[(i + points.size() - 1) % points.size()];
+            glm::vec2 next = points[(i + 1) % points.size()];
+            glm::vec2 in = points[i] - prev, out = next - points[i];
+            if (std::abs(cross(in, out)) <= COLLINEAR_TOLERANCE * glm::length(in) * glm::length(out)) {
+                points.erase(points.begin() + i);
+                removed = true;
+                --i;
+            }
+        }
+    }
+    if (points.size() < 3) return false;
+
+    float area = signedArea(points);
+    if (!(std::abs(area) > 0.0f)) return false;
+    if (area < 0.0f) std::reverse(points.begin(), points.end());
+
+    int n = static_cast<int>(points.size());
+    for (int i = 0; i < n; ++i) {
+        for (int j = i + 2; j < n; ++j) {
+            if (i == 0 && j == n - 1) continue;
+            if (segmentsIntersect(points[i], points[i + 1], points[j], points[(j + 1) % n])) return false;
+        }
+    }
+
+    glm::vec2 low(FLT_MAX), high(-FLT_MAX);
+    for (glm::vec2 p : points) {
+        low = glm::min(low, p);
+        high = glm::max(high, p);
+    }
+    glm::vec2 center = (low + high) * 0.5f;
+    float scale = 1.0f / std::max(high.x - low.x, high.y - low.y);
+    for (glm::vec2& p : points) p = (p - center) * scale;
+
+    std::vector<int> triangles;
+    if (!triangulatePolygon(points, triangles)) return false;
+    shape.outline = points;
+    shape.triangles = triangles;
+    shape.halfExtent = (high - low) * scale * 0.5f;
+    return true;
+}
+
+// Walks round the remaining corners clipping ears: convex corners whose
+// triangle holds no other remaining corner. A full lap without an ear
+// means the outline was not simple.
+bool triangulatePolygon(const std::vector<glm::vec2>& outline, std::vector<int>& triangles) {
+    int n = static_cast<int>(outline.size());
+    if (n < 3) return false;
+    std::vector<int> remaining(n);
+    std::iota(remaining.begin(), remaining.end(), 0);
+
+    int corner = 0, sinceClip = 0;
+    while (remaining.size() > 3) {
+        int count = static_cast<int>(remaining.size());
+        if (sinceClip >= count) return false;
+        corner %= count;
+        int i0 = remaining[(corner + count - 1) % count], i1 = remaining[corner], i2 = remaining[(corner + 1) % count];
+        glm::vec2 a = outline[i0], b = outline[i1], c = outline[i2];
+        bool ear = cross(b - a, c - b) > 0.0f;
+        for (int k = 0; k < count && ear; ++k) {
+            int other = remaining[k];
+            if (other == i0 || other == i1 || other == i2) continue;
+            if (isInTriangle(outline[other], a, b, c)) ear = false;
+        }
+        if (!ear) {
+            ++corner;
+            ++sinceClip;
+            continue;
+        }
+        triangles.push_back(i0);
+        triangles.push_back(i1);
+        triangles.push_back(i2);
+        remaining.erase(remaining.begin() + corner);
+        sinceClip = 0;
+    }
+    triangles.push_back(remaining[0]);
+    triangles.push_back(remaining[1]);
+    triangles.push_back(remaining[2]);
+    return true;
+}
+
+std::vector<glm::vec2> makeStarVertices(int points, float innerRadius) {
+    std::vector<glm::vec2> vertices;
+    for (int i = 0; i < 2 * points; ++i) {
+        float angle = 3.14159265f * i / points;
+        float radius = i % 2 == 0 ? 1.0f : innerRadius;
+        vertices.push_back(radius * glm::vec2(std::sin(angle), std::cos(angle)));
+    }
+    return vertices;
+}
+
+// Distance to the nearest edge, with the sign from a crossing-number test
+// done in the same loop.
+float polygonDistance(glm::vec2 p, const PolygonShape& shape, glm::vec2 position, float size) {
+    const std::vector<glm::vec2>& outline = shape.outline;
+    float best = FLT_MAX;
+    bool inside = false;
+    for (size_t i = 0, j = outline.size() - 1; i < outline.size(); j = i++) {
+        glm::vec2 vi = position + outline[i] * size, vj = position + outline[j] * size;
+        glm::vec2 e = vj - vi, w = p - vi;
+        glm::vec2 b = w - e * glm::clamp(glm::dot(w, e) / glm::dot(e, e), 0.0f, 1.0f);
+        best = std::min(best, glm::dot(b, b));
+        bool above = p.y >= vi.y, below = p.y < vj.y, left = e.x * w.y > e.y * w.x;
+        if ((above && below && left) || (!above && !below && !left)) inside = !inside;
+    }
+    float distance = std::sqrt(best);
+    return inside ? -distance : distance;
+}
+
+bool isPointInPolygon(glm::vec2 p, const PolygonShape& shape, glm::vec2 position, float size) {
+    return polygonDistance(p, shape, position, size) < 0.0f;
+}
@@ -0,0 +1,41 @@
+#ifndef POLYGON_SHAPE_H
+#define POLYGON_SHAPE_H
+
+#include <glm/glm.hpp>
+#include <vector>
+
+// Outline of a polygon obstacle, shared by every obstacle of that shape.
+// The outline is centered on its bounds and scaled so the longer side is
+// 1; an obstacle places it at its position, scaled by its size. Vertices
+// run with positive signed area, so (edge.y, -edge.x) points out of every
+// edge, and triangles holds the ear-clipped tessellation as index triples
+// for rendering.
+struct PolygonShape {
+    std::vector<glm::vec2> outline;
+    std::vector<int> triangles;
+    // Half the normalized bounds, at most 0.5 on either axis.
+    glm::vec2 halfExtent;
+};
+
+// Builds a shape from a simple polygon given in either winding. Repeated and
+// collinear vertices are dropped. Fails, leaving shape alone, for fewer
+// than three distinct corners, zero area or crossing edges.
+bool makePolygonShape(const std::vector<glm::vec2>& vertices, PolygonShape& shape);
+
+// Ear clipping of a simple polygon with positive signed area, in O(n^2).
+// Appends n - 2 index triples to triangles; returns false if the outline
+// turns out not to be simple.
+bool triangulatePolygon(const std::vector<glm::vec2>& outline, std::vector<int>& triangles);
+
+// Outline of a star with the given number of points, outer radius 1 and
+// inner radius innerRadius: concave for innerRadius below cos(pi / points).
+std::vector<glm::vec2> makeStarVertices(int points, float innerRadius);
+
+// Signed distance from p to the shape placed at position with size,
+// negative inside.
+float polygonDistance(glm::vec2 p, const PolygonShape& shape, glm::vec2 position, float size);
+
+// Whether p lies inside the shape placed at position with size.
+bool isPointInPolygon(glm::vec2 p, const PolygonShape& shape, glm::vec2 position, float size);
+
+#endif // !POLYGON_SHAPE_H
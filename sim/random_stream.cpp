@@ -0,0 +1,55 @@
+#include "random_stream.h"
+#include <cmath>
+
+static const float TWO_PI = 6.28318530718f;
+
+static uint64_t splitMix(uint64_t x) {
+    x += 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void RandomStream::reseed(uint64_t seed, uint64_t stream) {
+    uint64_t key = splitMix(seed ^ splitMix(stream));
+    key0 = static_cast<uint32_t>(key);
+    key1 = static_cast<uint32_t>(key >> 32);
+    counter = 0;
+}
+
+float RandomStream::normal() {
+    // 1 - u keeps the log argument in (0, 1].
+    float radius = std::sqrt(-2.0f * std::log(1.0f - nextFloat()));
+    return radius * std::cos(TWO_PI * nextFloat());
+}
+
+void RandomStream::fillUniform(float* out, int count, float min, float max) {
+    float range = max - min;
+    uint64_t base = counter;
+    for (int i = 0; i < count; ++i) {
+        out[i] = min + toUnit(generate(base + i)) * range;
+    }
+    counter += count;
+}
+
+void RandomStream::fillNormal(float* out, int count, float mean, float deviation) {
+    // Both Box-Muller outputs are used, so each pair costs two draws.
+    uint64_t base = counter;
+    for (int i = 0; i < count; i += 2) {
+        float radius = std::sqrt(-2.0f * std::log(1.0f - toUnit(generate(base + i))));
+        float angle = TWO_PI * toUnit(generate(base + i + 1));
+        out[i] = mean + radius * std::cos(angle) * deviation;
+        if (i + 1 < count) out[i + 1] = mean + radius * std::sin(angle) * deviation;
+    }
+    counter += (count + 1) & ~1;
+}
+
+glm::vec2 circularRand(RandomStream& random, float radius) {
+    float angle = random.uniform(0.0f, TWO_PI);
+    return glm::vec2(std::cos(angle), std::sin(angle)) * radius;
+}
+
+glm::vec2 diskRand(RandomStream& random, float radius) {
+    // sqrt keeps the density uniform over the area.
+    return circularRand(random, radius * std::sqrt(random.nextFloat()));
+}
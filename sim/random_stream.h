@@ -0,0 +1,78 @@
+#ifndef RANDOM_STREAM_H
+#define RANDOM_STREAM_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+
+// Counter-based random numbers: draw n of a stream is a hash of n and the
+// stream's key, so streams hold no shared state, any (seed, stream) pair
+// replays exactly, and a batch of draws is a plain loop the compiler can
+// vectorize. Give every emitter or worker thread its own stream id under
+// the same seed rather than sharing one stream between them.
+class RandomStream {
+public:
+    explicit RandomStream(uint64_t seed = 0, uint64_t stream = 0) { reseed(seed, stream); }
+
+    // Restarts at draw 0 of the given stream.
+    void reseed(uint64_t seed, uint64_t stream = 0);
+    // Index of the next draw. Seeking lets several threads each produce
+    // their own part of one long batch.
+    uint64_t tell() const { return counter; }
+    void seek(uint64_t position) { counter = position; }
+
+    uint32_t nextUInt() { return generate(counter++); }
+    // Uniform in [0, 1).
+    float nextFloat() { return toUnit(nextUInt()); }
+    float uniform(float min, float max) { return min + nextFloat() * (max - min); }
+    // Standard normal, via Box-Muller.
+    float normal();
+
+    // Batch versions of uniform() and normal(); out needs no alignment.
+    void fillUniform(float* out, int count, float min, float max);
+    void fillNormal(float* out, int count, float mean, float deviation);
+
+private:
+    static uint32_t mix(uint32_t x) {
+        x ^= x >> 16;
+        x *= 0x7feb352dU;
+        x ^= x >> 15;
+        x *= 0x846ca68bU;
+        x ^= x >> 16;
+        return x;
+    }
+
+    static float toUnit(uint32_t bits) {
+        return static_cast<float>(bits >> 8) * (1.0f / 16777216.0f);
+    }
+
+    uint32_t generate(uint64_t n) const {
+        return mix(mix(static_cast<uint32_t>(n) + key0) ^ (static_cast<uint32_t>(n >> 32) + key1));
+    }
+
+    uint32_t key0, key1;
+    uint64_t counter;
+};
+
+// Stand-ins for glm/gtc/random.hpp, which draws from std::rand(), taking the
+// stream to draw from as the first argument.
+template <glm::length_t L, glm::qualifier Q>
+glm::vec<L, float, Q> linearRand(RandomStream& random, const glm::vec<L, float, Q>& min, const glm::vec<L, float, Q>& max) {
+    glm::vec<L, float, Q> result;
+    for (glm::length_t i = 0; i < L; ++i) result[i] = random.uniform(min[i], max[i]);
+    return result;
+}
+
+inline float linearRand(RandomStream& random, float min, float max) {
+    return random.uniform(min, max);
+}
+
+inline float gaussRand(RandomStream& random, float mean, float deviation) {
+    return mean + random.normal() * deviation;
+}
+
+// Uniform point on the circle of the given radius.
+glm::vec2 circularRand(RandomStream& random, float radius);
+// Uniform point inside the disc of the given radius.
+glm::vec2 diskRand(RandomStream& random, float radius);
+
+#endif // !RANDOM_STREAM_H
@@ -0,0 +1,549 @@
+#include "scene_file.h"
+#include <algorithm>
+#include <climits>
+#include <cstring>
+#include <memory>
+#include <type_traits>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+static const char SCENE_MAGIC[8] = { 'P', 'S', 'C', 'E', 'N', 'E', 0, 0 };
+static const uint32_t SCENE_BYTE_ORDER = 0x01020304u;
+
+// Records are used straight from the mapping, so their layout is the file
+// format: no padding anywhere, and nothing that needs constructing.
+static_assert(sizeof(SceneHeader) == 176, "SceneHeader layout changed");
+static_assert(sizeof(SceneSettings) == 296, "SceneSettings layout changed");
+static_assert(sizeof(SceneShape) == 24, "SceneShape layout changed");
+static_assert(sizeof(SceneEmitter) == 80, "SceneEmitter layout changed");
+static_assert(sizeof(Obstacle) == 20 && std::is_trivially_copyable<Obstacle>::value, "Obstacle layout changed");
+static_assert(sizeof(SceneParticlePage) == 8 * PARTICLE_PAGE_SIZE * sizeof(float), "SceneParticlePage layout changed");
+static_assert(sizeof(glm::vec2) == 8 && sizeof(glm::vec4) == 16, "glm vectors must be unaligned");
+
+static const char* OBSTACLE_TYPE_NAMES[OBSTACLE_TYPE_COUNT] = { "square", "triangle", "circle", "polygon" };
+
+static uint64_t alignSection(uint64_t offset) {
+    return (offset + SCENE_ALIGNMENT - 1) / SCENE_ALIGNMENT * SCENE_ALIGNMENT;
+}
+
+static void forEachPage(JobSystem* jobs, int pages, const std::function<void(int, int, int)>& body) {
+    if (jobs) {
+        jobs->parallelFor(pages, 1, body);
+    }
+    else {
+        body(0, pages, 0);
+    }
+}
+
+// Copies the first count entries of every column; the rest of to is left
+// as it is.
+static void copyParticles(const SceneParticlePage& from, const ParticleColumns& to, int count) {
+    std::copy(from.x, from.x + count, to.x);
+    std::copy(from.y, from.y + count, to.y);
+    std::copy(from.prevX, from.prevX + count, to.prevX);
+    std::copy(from.prevY, from.prevY + count, to.prevY);
+    std::copy(from.vx, from.vx + count, to.vx);
+    std::copy(from.vy, from.vy + count, to.vy);
+    std::copy(from.lifetime, from.lifetime + count, to.lifetime);
+    std::copy(from.color, from.color + count, to.color);
+}
+
+static void copyParticles(const ParticleColumns& from, int count, SceneParticlePage& to) {
+    std::copy(from.x, from.x + count, to.x);
+    std::copy(from.y, from.y + count, to.y);
+    std::copy(from.prevX, from.prevX + count, to.prevX);
+    std::copy(from.prevY, from.prevY + count, to.prevY);
+    std::copy(from.vx, from.vx + count, to.vx);
+    std::copy(from.vy, from.vy + count, to.vy);
+    std::copy(from.lifetime, from.lifetime + count, to.lifetime);
+    std::copy(from.color, from.color + count, to.color);
+}
+
+static SceneSettings toSceneSettings(const ParticleSettings& settings) {
+    SceneSettings out = {};
+    out.velocity = settings.velocity;
+    out.lifetime = settings.lifetime;
+    out.color = settings.color;
+    out.gradientStops = settings.colorOverLife.getStopCount();
+    for (int i = 0; i < out.gradientStops; ++i) {
+        out.gradientPositions[i] = settings.colorOverLife.getPositions()[i];
+        out.gradientColors[i] = settings.colorOverLife.getColors()[i];
+    }
+    out.gravityEnabled = settings.gravity.enabled;
+    out.gravitySolver = settings.gravity.solver;
+    out.gravityStrength = settings.gravity.strength;
+    out.gravitySoftening = settings.gravity.softening;
+    out.gravityTheta = settings.gravity.theta;
+    out.gravityMeshSize = settings.gravity.meshSize;
+    out.collisionsEnabled = settings.collisions.enabled;
+    out.collisionRadius = settings.collisions.radius;
+    out.collisionRestitution = settings.collisions.restitution;
+    out.fluidEnabled = settings.fluid.enabled;
+    out.fluidSmoothingRadius = settings.fluid.smoothingRadius;
+    out.fluidRestSpacing = settings.fluid.restSpacing;
+    out.fluidStiffness = settings.fluid.stiffness;
+    out.fluidViscosity = settings.fluid.viscosity;
+    out.fluidGravity = settings.fluid.gravity;
+    out.fluidBoundsMin = settings.fluid.boundsMin;
+    out.fluidBoundsMax = settings.fluid.boundsMax;
+    out.fluidSubsteps = settings.fluid.substeps;
+    out.reorderInterval = settings.reorder.interval;
+    out.reorderCellSize = settings.reorder.cellSize;
+    out.fieldEnabled = settings.obstacleField.enabled;
+    out.fieldCellSize = settings.obstacleField.cellSize;
+    out.fieldBand = settings.obstacleField.band;
+    out.tiledUpdate = settings.tiledUpdate;
+    return out;
+}
+
+static void fromSceneSettings(const SceneSettings& in, ParticleSettings& settings) {
+    settings.velocity = in.velocity;
+    settings.lifetime = in.lifetime;
+    settings.color = in.color;
+    settings.colorOverLife.setStops(in.gradientPositions, in.gradientColors, in.gradientStops);
+    settings.gravity.enabled = in.gravityEnabled != 0;
+    settings.gravity.solver = in.gravitySolver;
+    settings.gravity.strength = in.gravityStrength;
+    settings.gravity.softening = in.gravitySoftening;
+    settings.gravity.theta = in.gravityTheta;
+    settings.gravity.meshSize = in.gravityMeshSize;
+    settings.collisions.enabled = in.collisionsEnabled != 0;
+    settings.collisions.radius = in.collisionRadius;
+    settings.collisions.restitution = in.collisionRestitution;
+    settings.fluid.enabled = in.fluidEnabled != 0;
+    settings.fluid.smoothingRadius = in.fluidSmoothingRadius;
+    settings.fluid.restSpacing = in.fluidRestSpacing;
+    settings.fluid.stiffness = in.fluidStiffness;
+    settings.fluid.viscosity = in.fluidViscosity;
+    settings.fluid.gravity = in.fluidGravity;
+    settings.fluid.boundsMin = in.fluidBoundsMin;
+    settings.fluid.boundsMax = in.fluidBoundsMax;
+    settings.fluid.substeps = in.fluidSubsteps;
+    settings.reorder.interval = in.reorderInterval;
+    settings.reorder.cellSize = in.reorderCellSize;
+    settings.obstacleField.enabled = in.fieldEnabled != 0;
+    settings.obstacleField.cellSize = in.fieldCellSize;
+    settings.obstacleField.band = in.fieldBand;
+    settings.tiledUpdate = in.tiledUpdate != 0;
+}
+
+SceneFile::SceneFile() : data(nullptr), size(0) {
+#if defined(_WIN32)
+    file = INVALID_HANDLE_VALUE;
+    mapping = nullptr;
+#endif
+}
+
+SceneFile::~SceneFile() {
+    close();
+}
+
+bool SceneFile::open(const char* path) {
+    close();
+#if defined(_WIN32)
+    file = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    LARGE_INTEGER length;
+    if (!GetFileSizeEx(file, &length) || length.QuadPart < static_cast<LONGLONG>(sizeof(SceneHeader))) {
+        close();
+        return false;
+    }
+    mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    void* view = mapping ? MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0) : nullptr;
+    if (!view) {
+        close();
+        return false;
+    }
+    size = static_cast<size_t>(length.QuadPart);
+#else
+    int descriptor = ::open(path, O_RDONLY);
+    if (descriptor < 0) return false;
+    struct stat info;
+    if (fstat(descriptor, &info) != 0 || info.st_size < static_cast<off_t>(sizeof(SceneHeader))) {
+        ::close(descriptor);
+        return false;
+    }
+    // The mapping keeps the file alive on its own. Faulting every page in
+    // up front costs far less than taking the faults one by one later.
+    int flags = MAP_PRIVATE;
+#if defined(MAP_POPULATE)
+    flags |= MAP_POPULATE;
+#endif
+    void* view = mmap(nullptr, static_cast<size_t>(info.st_size), PROT_READ, flags, descriptor, 0);
+    ::close(descriptor);
+    if (view == MAP_FAILED) return false;
+    size = static_cast<size_t>(info.st_size);
+#endif
+    data = static_cast<const char*>(view);
+    if (!checkRecords()) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+void SceneFile::close() {
+#if defined(_WIN32)
+    if (data) UnmapViewOfFile(data);
+    if (mapping) CloseHandle(mapping);
+    if (file != INVALID_HANDLE_VALUE) CloseHandle(file);
+    mapping = nullptr;
+    file = INVALID_HANDLE_VALUE;
+#else
+    if (data) munmap(const_cast<char*>(data), size);
+#endif
+    data = nullptr;
+    size = 0;
+}
+
+template<class T>
+bool SceneFile::checkSection(const SceneSection& section) const {
+    if (section.offset % SCENE_ALIGNMENT != 0 || section.offset > size) return false;
+    return section.count <= (size - section.offset) / sizeof(T) && section.count <= static_cast<uint64_t>(INT_MAX);
+}
+
+// Runs once per open over the small sections and the obstacles; the
+// particle pages need no check beyond their number, since any bit pattern
+// is a valid column entry.
+bool SceneFile::checkRecords() const {
+    const SceneHeader& header = getHeader();
+    if (std::memcmp(header.magic, SCENE_MAGIC, sizeof(SCENE_MAGIC)) != 0) return false;
+    if (header.version != SCENE_VERSION || header.byteOrder != SCENE_BYTE_ORDER || header.fileSize != size) return false;
+    if (!checkSection<SceneSettings>(header.settings) || header.settings.count != 1) return false;
+    if (!checkSection<SceneShape>(header.shapes) || !checkSection<glm::vec2>(header.shapeVertices) ||
+        !checkSection<int32_t>(header.shapeTriangles) || !checkSection<SceneEmitter>(header.emitters) ||
+        !checkSection<glm::vec4>(header.palette) || !checkSection<Obstacle>(header.obstacles) ||
+        !checkSection<SceneParticlePage>(header.particles)) {
+        return false;
+    }
+    if (header.capacity < 0 || header.particleCount < 0 || header.pageSize != PARTICLE_PAGE_SIZE) return false;
+    if (!header.snapshot && header.particleCount != 0) return false;
+    uint64_t pages = (uint64_t(header.particleCount) + PARTICLE_PAGE_SIZE - 1) >> PARTICLE_PAGE_SHIFT;
+    if (header.particles.count != pages) return false;
+
+    int stops = getSettings().gradientStops;
+    if (stops < 1 || stops > ColorGradient::MAX_STOPS) return false;
+
+    const SceneShape* shapes = getShapes();
+    const int32_t* triangles = getShapeTriangles();
+    for (uint64_t i = 0; i < header.shapes.count; ++i) {
+        const SceneShape& shape = shapes[i];
+        if (shape.vertexCount < 3 || shape.indexCount != 3 * (shape.vertexCount - 2)) return false;
+        if (uint64_t(shape.firstVertex) + shape.vertexCount > header.shapeVertices.count) return false;
+        if (uint64_t(shape.firstIndex) + shape.indexCount > header.shapeTriangles.count) return false;
+        for (uint32_t k = 0; k < shape.indexCount; ++k) {
+            int32_t index = triangles[shape.firstIndex + k];
+            if (index < 0 || index >= static_cast<int32_t>(shape.vertexCount)) return false;
+        }
+    }
+
+    const SceneEmitter* emitters = getEmitters();
+    for (uint64_t i = 0; i < header.emitters.count; ++i) {
+        if (uint64_t(emitters[i].firstColor) + emitters[i].colorCount > header.palette.count) return false;
+    }
+
+    const Obstacle* obstacles = getObstacles();
+    for (uint64_t i = 0; i < header.obstacles.count; ++i) {
+        const Obstacle& obstacle = obstacles[i];
+        if (obstacle.type < 0 || obstacle.type >= OBSTACLE_TYPE_COUNT) return false;
+        if (obstacle.type == OBSTACLE_POLYGON && (obstacle.shape < 0 || uint64_t(obstacle.shape) >= header.shapes.count)) return false;
+    }
+    return true;
+}
+
+const SceneHeader& SceneFile::getHeader() const {
+    return *reinterpret_cast<const SceneHeader*>(data);
+}
+
+const SceneSettings& SceneFile::getSettings() const {
+    return *getSection<SceneSettings>(getHeader().settings);
+}
+
+const SceneShape* SceneFile::getShapes() const {
+    return getSection<SceneShape>(getHeader().shapes);
+}
+
+const glm::vec2* SceneFile::getShapeVertices() const {
+    return getSection<glm::vec2>(getHeader().shapeVertices);
+}
+
+const int32_t* SceneFile::getShapeTriangles() const {
+    return getSection<int32_t>(getHeader().shapeTriangles);
+}
+
+const SceneEmitter* SceneFile::getEmitters() const {
+    return getSection<SceneEmitter>(getHeader().emitters);
+}
+
+const glm::vec4* SceneFile::getPalette() const {
+    return getSection<glm::vec4>(getHeader().palette);
+}
+
+const Obstacle* SceneFile::getObstacles() const {
+    return getSection<Obstacle>(getHeader().obstacles);
+}
+
+const SceneParticlePage* SceneFile::getParticlePages() const {
+    return getSection<SceneParticlePage>(getHeader().particles);
+}
+
+void SceneFile::apply(ParticleSystem& system, JobSystem* jobs) const {
+    const SceneHeader& header = getHeader();
+    fromSceneSettings(getSettings(), system.getSettings());
+    system.clearEmitters();
+    system.clearPolygonShapes();
+    system.setSeed(header.seed);
+
+    const SceneShape* shapes = getShapes();
+    const glm::vec2* vertices = getShapeVertices();
+    const int32_t* triangles = getShapeTriangles();
+    for (uint64_t i = 0; i < header.shapes.count; ++i) {
+        const SceneShape& record = shapes[i];
+        PolygonShape shape;
+        shape.outline.assign(vertices + record.firstVertex, vertices + record.firstVertex + record.vertexCount);
+        shape.triangles.assign(triangles + record.firstIndex, triangles + record.firstIndex + record.indexCount);
+        shape.halfExtent = record.halfExtent;
+        system.addPolygonShape(shape);
+    }
+
+    const SceneEmitter* emitters = getEmitters();
+    const glm::vec4* palette = getPalette();
+    for (uint64_t i = 0; i < header.emitters.count; ++i) {
+        const SceneEmitter& record = emitters[i];
+        Emitter emitter;
+        emitter.position = record.position;
+        emitter.rate = record.rate;
+        emitter.burstCount = record.burstCount;
+        emitter.enabled = record.enabled != 0;
+        emitter.velocityMin = record.velocityMin;
+        emitter.velocityMax = record.velocityMax;
+        emitter.lifetimeMin = record.lifetimeMin;
+        emitter.lifetimeMax = record.lifetimeMax;
+        emitter.color = record.color;
+        emitter.palette.assign(palette + record.firstColor, palette + record.firstColor + record.colorCount);
+        emitter.accumulator = record.accumulator;
+        system.getEmitter(system.addEmitter(emitter)).random.seek(record.draws);
+    }
+
+    system.addObstacles(getObstacles(), static_cast<int>(header.obstacles.count));
+
+    if (!header.snapshot) return;
+    int count = header.particleCount;
+    ParticlePool& pool = system.getPool();
+    system.resize(std::max(header.capacity, count));
+    pool.clear();
+    pool.allocate(count);
+    const SceneParticlePage* pages = getParticlePages();
+    forEachPage(jobs, pool.getLivePageCount(), [&](int begin, int end, int) {
+        for (int page = begin; page < end; ++page) {
+            int base = page << PARTICLE_PAGE_SHIFT;
+            copyParticles(pages[page], pool.getPage(page), std::min(count - base, PARTICLE_PAGE_SIZE));
+        }
+    });
+}
+
+static void writeFloats(std::FILE* out, const char* name, const float* values, int count) {
+    std::fprintf(out, "%s", name);
+    for (int i = 0; i < count; ++i) {
+        std::fprintf(out, " %.9g", values[i]);
+    }
+    std::fprintf(out, "\n");
+}
+
+static void writeVector(std::FILE* out, const char* name, glm::vec2 value) {
+    writeFloats(out, name, &value.x, 2);
+}
+
+static void writeVector(std::FILE* out, const char* name, glm::vec4 value) {
+    writeFloats(out, name, &value.x, 4);
+}
+
+void SceneFile::writeText(std::FILE* out) const {
+    const SceneHeader& header = getHeader();
+    const SceneSettings& settings = getSettings();
+    std::fprintf(out, "scene %u\n", header.version);
+    std::fprintf(out, "seed %llu\n", static_cast<unsigned long long>(header.seed));
+    std::fprintf(out, "capacity %d\n", header.capacity);
+
+    std::fprintf(out, "velocity %.9g\n", settings.velocity);
+    std::fprintf(out, "lifetime %.9g\n", settings.lifetime);
+    writeVector(out, "color", settings.color);
+    for (int i = 0; i < settings.gradientStops; ++i) {
+        std::fprintf(out, "gradient-stop %.9g", settings.gradientPositions[i]);
+        writeVector(out, "", settings.gradientColors[i]);
+    }
+    std::fprintf(out, "gravity %u solver %d strength %.9g softening %.9g theta %.9g mesh %d\n", settings.gravityEnabled,
+        settings.gravitySolver, settings.gravityStrength, settings.gravitySoftening, settings.gravityTheta, settings.gravityMeshSize);
+    std::fprintf(out, "collisions %u radius %.9g restitution %.9g\n", settings.collisionsEnabled, settings.collisionRadius,
+        settings.collisionRestitution);
+    std::fprintf(out, "fluid %u smoothing %.9g spacing %.9g stiffness %.9g viscosity %.9g substeps %d\n", settings.fluidEnabled,
+        settings.fluidSmoothingRadius, settings.fluidRestSpacing, settings.fluidStiffness, settings.fluidViscosity, settings.fluidSubsteps);
+    writeVector(out, "fluid-gravity", settings.fluidGravity);
+    writeVector(out, "fluid-bounds-min", settings.fluidBoundsMin);
+    writeVector(out, "fluid-bounds-max", settings.fluidBoundsMax);
+    std::fprintf(out, "reorder %d cell %.9g\n", settings.reorderInterval, settings.reorderCellSize);
+    std::fprintf(out, "field %u cell %.9g band %.9g\n", settings.fieldEnabled, settings.fieldCellSize, settings.fieldBand);
+    std::fprintf(out, "tiled %u\n", settings.tiledUpdate);
+
+    const SceneShape* shapes = getShapes();
+    const glm::vec2* vertices = getShapeVertices();
+    const int32_t* triangles = getShapeTriangles();
+    for (uint64_t i = 0; i < header.shapes.count; ++i) {
+        const SceneShape& shape = shapes[i];
+        std::fprintf(out, "shape %llu vertices %u half-extent %.9g %.9g\n", static_cast<unsigned long long>(i), shape.vertexCount,
+            shape.halfExtent.x, shape.halfExtent.y);
+        for (uint32_t k = 0; k < shape.vertexCount; ++k) {
+            writeVector(out, "vertex", vertices[shape.firstVertex + k]);
+        }
+        for (uint32_t k = 0; k < shape.indexCount; k += 3) {
+            const int32_t* triangle = triangles + shape.firstIndex + k;
+            std::fprintf(out, "triangle %d %d %d\n", triangle[0], triangle[1], triangle[2]);
+        }
+    }
+
+    const SceneEmitter* emitters = getEmitters();
+    const glm::vec4* palette = getPalette();
+    for (uint64_t i = 0; i < header.emitters.count; ++i) {
+        const SceneEmitter& emitter = emitters[i];
+        std::fprintf(out, "emitter %llu enabled %u rate %.9g burst %d accumulator %.9g draws %llu\n", static_cast<unsigned long long>(i),
+            emitter.enabled, emitter.rate, emitter.burstCount, emitter.accumulator, static_cast<unsigned long long>(emitter.draws));
+        writeVector(out, "position", emitter.position);
+        writeVector(out, "velocity-min", emitter.velocityMin);
+        writeVector(out, "velocity-max", emitter.velocityMax);
+        std::fprintf(out, "lifetime %.9g %.9g\n", emitter.lifetimeMin, emitter.lifetimeMax);
+        writeVector(out, "color", emitter.color);
+        for (uint32_t k = 0; k < emitter.colorCount; ++k) {
+            writeVector(out, "palette", palette[emitter.firstColor + k]);
+        }
+    }
+
+    const Obstacle* obstacles = getObstacles();
+    for (uint64_t i = 0; i < header.obstacles.count; ++i) {
+        const Obstacle& obstacle = obstacles[i];
+        std::fprintf(out, "obstacle %s %.9g %.9g %.9g", OBSTACLE_TYPE_NAMES[obstacle.type], obstacle.position.x, obstacle.position.y, obstacle.size);
+        if (obstacle.type == OBSTACLE_POLYGON) std::fprintf(out, " shape %d", obstacle.shape);
+        std::fprintf(out, "\n");
+    }
+
+    if (!header.snapshot) return;
+    std::fprintf(out, "particles %d\n", header.particleCount);
+    const SceneParticlePage* pages = getParticlePages();
+    for (int i = 0; i < header.particleCount; ++i) {
+        const SceneParticlePage& page = pages[i >> PARTICLE_PAGE_SHIFT];
+        int k = i & (PARTICLE_PAGE_SIZE - 1);
+        std::fprintf(out, "particle %.9g %.9g %.9g %.9g %.9g %.9g %.9g %08x\n", page.x[k], page.y[k], page.prevX[k], page.prevY[k],
+            page.vx[k], page.vy[k], page.lifetime[k], page.color[k]);
+    }
+}
+
+static bool writeSection(std::FILE* out, uint64_t& written, const SceneSection& section, const void* records, size_t recordSize) {
+    static const char padding[SCENE_ALIGNMENT] = {};
+    if (std::fwrite(padding, 1, section.offset - written, out) != section.offset - written) return false;
+    size_t bytes = section.count * recordSize;
+    if (bytes > 0 && std::fwrite(records, 1, bytes, out) != bytes) return false;
+    written = section.offset + bytes;
+    return true;
+}
+
+bool saveScene(const char* path, ParticleSystem& system, bool particles) {
+    SceneSettings settings = toSceneSettings(system.getSettings());
+
+    std::vector<SceneShape> shapes;
+    std::vector<glm::vec2> vertices;
+    std::vector<int32_t> triangles;
+    for (int i = 0; i < system.getPolygonShapeCount(); ++i) {
+        const PolygonShape& shape = system.getPolygonShape(i);
+        SceneShape record = { static_cast<uint32_t>(vertices.size()), static_cast<uint32_t>(shape.outline.size()),
+            static_cast<uint32_t>(triangles.size()), static_cast<uint32_t>(shape.triangles.size()), shape.halfExtent };
+        shapes.push_back(record);
+        vertices.insert(vertices.end(), shape.outline.begin(), shape.outline.end());
+        triangles.insert(triangles.end(), shape.triangles.begin(), shape.triangles.end());
+    }
+
+    std::vector<SceneEmitter> emitters;
+    std::vector<glm::vec4> palette;
+    for (const Emitter& emitter : system.getEmitters()) {
+        SceneEmitter record = {};
+        record.position = emitter.position;
+        record.rate = emitter.rate;
+        record.burstCount = emitter.burstCount;
+        record.velocityMin = emitter.velocityMin;
+        record.velocityMax = emitter.velocityMax;
+        record.lifetimeMin = emitter.lifetimeMin;
+        record.lifetimeMax = emitter.lifetimeMax;
+        record.color = emitter.color;
+        record.firstColor = static_cast<uint32_t>(palette.size());
+        record.colorCount = static_cast<uint32_t>(emitter.palette.size());
+        record.accumulator = emitter.accumulator;
+        record.enabled = emitter.enabled;
+        record.draws = emitter.random.tell();
+        emitters.push_back(record);
+        palette.insert(palette.end(), emitter.palette.begin(), emitter.palette.end());
+    }
+
+    ParticlePool& pool = system.getPool();
+    int particleCount = particles ? pool.getLiveCount() : 0;
+    int particlePages = (particleCount + PARTICLE_PAGE_SIZE - 1) >> PARTICLE_PAGE_SHIFT;
+
+    const std::vector<Obstacle>& obstacles = system.getObstacles();
+    SceneHeader header = {};
+    std::memcpy(header.magic, SCENE_MAGIC, sizeof(SCENE_MAGIC));
+    header.version = SCENE_VERSION;
+    header.byteOrder = SCENE_BYTE_ORDER;
+    header.seed = system.getSeed();
+    header.capacity = pool.getCapacity();
+    header.snapshot = particles;
+    header.particleCount = particleCount;
+    header.pageSize = PARTICLE_PAGE_SIZE;
+    uint64_t offset = alignSection(sizeof(SceneHeader));
+    auto place = [&](SceneSection& section, size_t count, size_t recordSize) {
+        section.offset = offset;
+        section.count = count;
+        offset = alignSection(offset + count * recordSize);
+    };
+    place(header.settings, 1, sizeof(SceneSettings));
+    place(header.shapes, shapes.size(), sizeof(SceneShape));
+    place(header.shapeVertices, vertices.size(), sizeof(glm::vec2));
+    place(header.shapeTriangles, triangles.size(), sizeof(int32_t));
+    place(header.emitters, emitters.size(), sizeof(SceneEmitter));
+    place(header.palette, palette.size(), sizeof(glm::vec4));
+    place(header.obstacles, obstacles.size(), sizeof(Obstacle));
+    place(header.particles, particlePages, sizeof(SceneParticlePage));
+    header.fileSize = offset;
+
+    std::FILE* out = std::fopen(path, "wb");
+    if (!out) return false;
+    uint64_t written = 0;
+    SceneSection headerSection = { 0, 1 };
+    SceneSection end = { header.fileSize, 0 };
+    bool ok = writeSection(out, written, headerSection, &header, sizeof(SceneHeader)) &&
+        writeSection(out, written, header.settings, &settings, sizeof(SceneSettings)) &&
+        writeSection(out, written, header.shapes, shapes.data(), sizeof(SceneShape)) &&
+        writeSection(out, written, header.shapeVertices, vertices.data(), sizeof(glm::vec2)) &&
+        writeSection(out, written, header.shapeTriangles, triangles.data(), sizeof(int32_t)) &&
+        writeSection(out, written, header.emitters, emitters.data(), sizeof(SceneEmitter)) &&
+        writeSection(out, written, header.palette, palette.data(), sizeof(glm::vec4)) &&
+        writeSection(out, written, header.obstacles, obstacles.data(), sizeof(Obstacle)) &&
+        writeSection(out, written, header.particles, nullptr, 0);
+    // Pages go out one at a time through a single record. Only the last
+    // can be partial; its entries past the live particles are zeroed.
+    std::unique_ptr<SceneParticlePage> record(new SceneParticlePage());
+    for (int page = 0; ok && page < particlePages; ++page) {
+        int live = std::min(particleCount - (page << PARTICLE_PAGE_SHIFT), PARTICLE_PAGE_SIZE);
+        if (live < PARTICLE_PAGE_SIZE) std::memset(record.get(), 0, sizeof(SceneParticlePage));
+        copyParticles(pool.getPage(page), live, *record);
+        ok = std::fwrite(record.get(), sizeof(SceneParticlePage), 1, out) == 1;
+    }
+    written += uint64_t(particlePages) * sizeof(SceneParticlePage);
+    ok = ok && writeSection(out, written, end, nullptr, 0);
+    return std::fclose(out) == 0 && ok;
+}
@@ -0,0 +1,187 @@
+#ifndef SCENE_FILE_H
+#define SCENE_FILE_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <glm/glm.hpp>
+#include "job_system.h"
+#include "obstacle.h"
+#include "particle_system.h"
+
+// Scene files are little-endian and start with a SceneHeader. Every other
+// part is a section: an array of fixed-size records at an offset aligned
+// to SCENE_ALIGNMENT, so a mapped file is used in place. Obstacles are
+// stored as Obstacle records and particles as whole pages of the pool's
+// own columns, so a snapshot loads back bit for bit. A file with another
+// version is refused, never converted.
+const uint32_t SCENE_VERSION = 2;
+const size_t SCENE_ALIGNMENT = 64;
+
+struct SceneSection {
+    uint64_t offset;
+    uint64_t count;
+};
+
+struct SceneHeader {
+    // "PSCENE" followed by two zero bytes.
+    char magic[8];
+    uint32_t version;
+    // 0x01020304 as written; reads back otherwise on a big-endian machine.
+    uint32_t byteOrder;
+    uint64_t fileSize;
+    uint64_t seed;
+    // Pool size the scene was saved with.
+    int32_t capacity;
+    // 1 if the particle section is a snapshot, even an empty one; 0 if the
+    // scene has none.
+    int32_t snapshot;
+    // Live particles in the snapshot, and the page size it was cut into;
+    // a file saved with another PARTICLE_PAGE_SIZE is refused.
+    int32_t particleCount;
+    int32_t pageSize;
+    SceneSection settings;
+    SceneSection shapes;
+    SceneSection shapeVertices;
+    SceneSection shapeTriangles;
+    SceneSection emitters;
+    SceneSection palette;
+    SceneSection obstacles;
+    SceneSection particles;
+};
+
+// ParticleSettings with fixed-width fields; bools are 0 or 1.
+struct SceneSettings {
+    float velocity;
+    float lifetime;
+    glm::vec4 color;
+    int32_t gradientStops;
+    float gradientPositions[ColorGradient::MAX_STOPS];
+    glm::vec4 gradientColors[ColorGradient::MAX_STOPS];
+    uint32_t gravityEnabled;
+    int32_t gravitySolver;
+    float gravityStrength;
+    float gravitySoftening;
+    float gravityTheta;
+    int32_t gravityMeshSize;
+    uint32_t collisionsEnabled;
+    float collisionRadius;
+    float collisionRestitution;
+    uint32_t fluidEnabled;
+    float fluidSmoothingRadius;
+    float fluidRestSpacing;
+    float fluidStiffness;
+    float fluidViscosity;
+    glm::vec2 fluidGravity;
+    glm::vec2 fluidBoundsMin;
+    glm::vec2 fluidBoundsMax;
+    int32_t fluidSubsteps;
+    int32_t reorderInterval;
+    float reorderCellSize;
+    uint32_t fieldEnabled;
+    float fieldCellSize;
+    float fieldBand;
+    uint32_t tiledUpdate;
+};
+
+// A polygon shape's outline and tessellation, as ranges of the vertex and
+// triangle-index sections. Indices are relative to firstVertex.
+struct SceneShape {
+    uint32_t firstVertex;
+    uint32_t vertexCount;
+    uint32_t firstIndex;
+    uint32_t indexCount;
+    glm::vec2 halfExtent;
+};
+
+// An Emitter; its palette is a range of the palette section, and draws is
+// how far its random stream had got.
+struct SceneEmitter {
+    glm::vec2 position;
+    float rate;
+    int32_t burstCount;
+    glm::vec2 velocityMin;
+    glm::vec2 velocityMax;
+    float lifetimeMin;
+    float lifetimeMax;
+    glm::vec4 color;
+    uint32_t firstColor;
+    uint32_t colorCount;
+    float accumulator;
+    uint32_t enabled;
+    uint64_t draws;
+};
+
+// One page of a particle snapshot: the pool's columns as they are laid out
+// in a page. Entries past the live particles are zero.
+struct SceneParticlePage {
+    float x[PARTICLE_PAGE_SIZE];
+    float y[PARTICLE_PAGE_SIZE];
+    float prevX[PARTICLE_PAGE_SIZE];
+    float prevY[PARTICLE_PAGE_SIZE];
+    float vx[PARTICLE_PAGE_SIZE];
+    float vy[PARTICLE_PAGE_SIZE];
+    float lifetime[PARTICLE_PAGE_SIZE];
+    uint32_t color[PARTICLE_PAGE_SIZE];
+};
+
+// Read-only view of a mapped scene file. Every pointer it hands out points
+// into the mapping and stays valid until close().
+class SceneFile {
+public:
+    SceneFile();
+    ~SceneFile();
+    SceneFile(const SceneFile&) = delete;
+    SceneFile& operator=(const SceneFile&) = delete;
+
+    // Maps path and checks the header, that every section lies inside the
+    // file, and that every index in the records is in range; the geometry
+    // itself is trusted. Returns false, leaving the view closed, if any
+    // check fails.
+    bool open(const char* path);
+    void close();
+    bool isOpen() const { return data != nullptr; }
+
+    const SceneHeader& getHeader() const;
+    const SceneSettings& getSettings() const;
+    const SceneShape* getShapes() const;
+    const glm::vec2* getShapeVertices() const;
+    const int32_t* getShapeTriangles() const;
+    const SceneEmitter* getEmitters() const;
+    const glm::vec4* getPalette() const;
+    const Obstacle* getObstacles() const;
+    const SceneParticlePage* getParticlePages() const;
+
+    // Replaces system's settings, seed, emitters, polygon shapes and
+    // obstacles with the scene's. If the scene has a particle snapshot, the
+    // pool is resized to the saved capacity and each page's columns are
+    // copied from it; otherwise the live particles are left alone.
+    void apply(ParticleSystem& system, JobSystem* jobs = nullptr) const;
+
+    // Writes the scene as text, one record per line with floats printed
+    // round-trip exact, so two scenes can be compared with diff.
+    void writeText(std::FILE* out) const;
+
+private:
+    template<class T>
+    const T* getSection(const SceneSection& section) const {
+        return reinterpret_cast<const T*>(data + section.offset);
+    }
+    template<class T>
+    bool checkSection(const SceneSection& section) const;
+    bool checkRecords() const;
+
+    const char* data;
+    size_t size;
+#if defined(_WIN32)
+    void* file;
+    void* mapping;
+#endif
+};
+
+// Writes system's settings, seed, emitters, polygon shapes and obstacles to
+// path, plus a snapshot of the live particles when particles is set.
+// Returns false if the file cannot be written.
+bool saveScene(const char* path, ParticleSystem& system, bool particles);
+
+#endif // !SCENE_FILE_H
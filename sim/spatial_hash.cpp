@@ -0,0 +1,108 @@
+#include "spatial_hash.h"
+#include <algorithm>
+
+static const uint32_t EMPTY_KEY = 0xffffffffu;
+
+// Smallest table, so a handful of particles does not hash into a few buckets.
+static const uint32_t MIN_TABLE_SIZE = 1024;
+
+SpatialHash::SpatialHash() : cellSize(1.0f), inverseCellSize(1.0f), mask(0) {
+}
+
+void SpatialHash::build(const ParticlePool& pool, float newCellSize, JobSystem* jobs) {
+    cellSize = newCellSize;
+    inverseCellSize = 1.0f / cellSize;
+
+    int slots = pool.getLiveCount();
+    uint32_t tableSize = MIN_TABLE_SIZE;
+    while (tableSize < static_cast<uint32_t>(slots)) tableSize <<= 1;
+    mask = tableSize - 1;
+
+    // Particles that died this step stay in the pool until compaction and
+    // are left out.
+    keys.resize(slots);
+    auto hashPages = [&](int begin, int end, int) {
+        for (int page = begin; page < end; ++page) {
+            ParticleColumns p = pool.getPage(page);
+            int offset = page * PARTICLE_PAGE_SIZE;
+            int live = std::min(slots - offset, PARTICLE_PAGE_SIZE);
+            for (int i = 0; i < live; ++i) {
+                keys[offset + i] = p.lifetime[i] > 0.0f ? bucketOf(cellOf(p.x[i]), cellOf(p.y[i])) : EMPTY_KEY;
+            }
+        }
+    };
+    int pages = pool.getLivePageCount();
+    if (jobs) {
+        jobs->parallelFor(pages, 1, hashPages);
+    }
+    else {
+        hashPages(0, pages, 0);
+    }
+
+    starts.assign(tableSize + 1, 0);
+    int count = 0;
+    for (int s = 0; s < slots; ++s) {
+        if (keys[s] == EMPTY_KEY) continue;
+        starts[keys[s] + 1]++;
+        count++;
+    }
+    for (uint32_t b = 0; b < tableSize; ++b) {
+        starts[b + 1] += starts[b];
+    }
+
+    // Scattering advances starts[b] to the end of bucket b, which is where
+    // bucket b + 1 begins; shifting by one restores the starts.
+    particles.x.resize(count);
+    particles.y.resize(count);
+    particles.vx.resize(count);
+    particles.vy.resize(count);
+    particles.slot.resize(count);
+    for (int page = 0; page < pages; ++page) {
+        ParticleColumns p = pool.getPage(page);
+        int offset = page * PARTICLE_PAGE_SIZE;
+        int live = std::min(slots - offset, PARTICLE_PAGE_SIZE);
+        for (int i = 0; i < live; ++i) {
+            uint32_t key = keys[offset + i];
+            if (key == EMPTY_KEY) continue;
+            int target = starts[key]++;
+            particles.x[target] = p.x[i];
+            particles.y[target] = p.y[i];
+            particles.vx[target] = p.vx[i];
+            particles.vy[target] = p.vy[i];
+            particles.slot[target] = offset + i;
+        }
+    }
+    for (uint32_t b = tableSize; b > 0; --b) {
+        starts[b] = starts[b - 1];
+    }
+    starts[0] = 0;
+}
+
+int SpatialHash::getNeighborBuckets(glm::vec2 position, uint32_t* buckets) const {
+    int column = cellOf(position.x);
+    int row = cellOf(position.y);
+    int count = 0;
+    for (int dy = -1; dy <= 1; ++dy) {
+        for (int dx = -1; dx <= 1; ++dx) {
+            uint32_t bucket = bucketOf(column + dx, row + dy);
+            // Visiting a shared bucket twice would count its particles twice.
+            if (std::find(buckets, buckets + count, bucket) == buckets + count) {
+                buckets[count++] = bucket;
+            }
+        }
+    }
+    return count;
+}
+
+uint32_t SpatialHash::bucketOf(int column, int row) const {
+    return ((static_cast<uint32_t>(column) * 73856093u) ^ (static_cast<uint32_t>(row) * 19349663u)) & mask;
+}
+
+// floor() without the libm call; clamped so far-off or NaN coordinates
+// still land in some cell.
+int SpatialHash::cellOf(float coordinate) const {
+    float u = coordinate * inverseCellSize;
+    u = u > -1e9f ? (u < 1e9f ? u : 1e9f) : -1e9f;
+    int cell = static_cast<int>(u);
+    return u < static_cast<float>(cell) ? cell - 1 : cell;
+}
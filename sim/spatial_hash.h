@@ -0,0 +1,56 @@
+#ifndef SPATIAL_HASH_H
+#define SPATIAL_HASH_H
+
+#include <glm/glm.hpp>
+#include <cstdint>
+#include <vector>
+#include "job_system.h"
+#include "particle_pool.h"
+
+// Live particles bucketed by grid cell, rebuilt every step with a counting
+// sort: count per bucket, prefix sum, scatter. Cells are hashed into a
+// table sized to the particle count, so the grid needs no bounds. Two cells
+// can share a bucket, so callers still check distances.
+//
+// The particles are copied out in bucket order, which makes walking a
+// bucket a walk over contiguous memory. slot maps each copy back to the
+// pool.
+class SpatialHash {
+public:
+    struct SortedParticles {
+        std::vector<float> x, y, vx, vy;
+        std::vector<int> slot;
+    };
+
+    static const int MAX_NEIGHBOR_BUCKETS = 9;
+
+    SpatialHash();
+
+    void build(const ParticlePool& pool, float cellSize, JobSystem* jobs = nullptr);
+
+    // Distinct buckets of the 3x3 cells around position, which hold every
+    // particle within getCellSize() of it. Writes at most
+    // MAX_NEIGHBOR_BUCKETS and returns how many.
+    int getNeighborBuckets(glm::vec2 position, uint32_t* buckets) const;
+    // Bucket of the cell holding position.
+    uint32_t getBucket(glm::vec2 position) const { return bucketOf(cellOf(position.x), cellOf(position.y)); }
+    int getBucketBegin(uint32_t bucket) const { return starts[bucket]; }
+    int getBucketEnd(uint32_t bucket) const { return starts[bucket + 1]; }
+
+    const SortedParticles& getParticles() const { return particles; }
+    int getCount() const { return static_cast<int>(particles.slot.size()); }
+    float getCellSize() const { return cellSize; }
+
+private:
+    uint32_t bucketOf(int column, int row) const;
+    int cellOf(float coordinate) const;
+
+    float cellSize;
+    float inverseCellSize;
+    uint32_t mask;
+    std::vector<int> starts;
+    std::vector<uint32_t> keys;
+    SortedParticles particles;
+};
+
+#endif // !SPATIAL_HASH_H
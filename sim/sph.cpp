@@ -0,0 +1,189 @@
+#include "sph.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+static const float PI = 3.14159265f;
+
+// Neighbors tested per parcel. A parcel at rest has 9 (h / restSpacing)^2
+// in the 3x3 cells around it, 36 with the defaults; the cap only bites in
+// a pile such as a fresh emitter burst, where it keeps the pass O(N).
+static const int MAX_CANDIDATES = 256;
+
+static const int FLUID_CHUNK_SIZE = 2048;
+
+// Accumulators per sum; the inner loops run in blocks of this many
+// neighbors so they map onto vector registers.
+static const int LANES = PARTICLE_SIMD_WIDTH;
+
+// Coordinate of padding lanes: outside any kernel, yet its square is finite.
+static const float FAR_AWAY = 1.0e18f;
+
+static double millisecondsSince(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Indices of the particles in the neighbor buckets of position, at most
+// MAX_CANDIDATES. Returns how many, and in gotSelf whether parcel self was
+// among them: the cap can run out before its own bucket comes up, as in a
+// pile in the cell above it.
+static int gatherNeighbors(const SpatialHash& grid, glm::vec2 position, int self, int* neighbors, bool& gotSelf) {
+    uint32_t buckets[SpatialHash::MAX_NEIGHBOR_BUCKETS];
+    int bucketCount = grid.getNeighborBuckets(position, buckets);
+    int count = 0;
+    gotSelf = false;
+    for (int b = 0; b < bucketCount && count < MAX_CANDIDATES; ++b) {
+        int begin = grid.getBucketBegin(buckets[b]);
+        int end = std::min(grid.getBucketEnd(buckets[b]), begin + MAX_CANDIDATES - count);
+        gotSelf |= self >= begin && self < end;
+        for (int j = begin; j < end; ++j) {
+            neighbors[count++] = j;
+        }
+    }
+    return count;
+}
+
+static void runParallel(JobSystem* jobs, int count, const std::function<void(int, int, int)>& body) {
+    if (jobs) {
+        jobs->parallelFor(count, FLUID_CHUNK_SIZE, body);
+    }
+    else {
+        body(0, count, 0);
+    }
+}
+
+void FluidSolver::step(ParticlePool& pool, const FluidSettings& settings, float deltaTime, JobSystem* jobs, FluidTimings& timings) {
+    float h = settings.smoothingRadius;
+    if (!(h > 0.0f) || !(settings.restSpacing > 0.0f)) return;
+
+    auto start = std::chrono::steady_clock::now();
+    grid.build(pool, h, jobs);
+    timings.neighbors += millisecondsSince(start);
+
+    const SpatialHash::SortedParticles& s = grid.getParticles();
+    const float* PARTICLE_RESTRICT x = s.x.data();
+    const float* PARTICLE_RESTRICT y = s.y.data();
+    const float* PARTICLE_RESTRICT vx = s.vx.data();
+    const float* PARTICLE_RESTRICT vy = s.vy.data();
+    int count = grid.getCount();
+    density.resize(count);
+    pressure.resize(count);
+
+    float h2 = h * h;
+    float h5 = h2 * h2 * h;
+    float poly6 = 4.0f / (PI * h5 * h2 * h);
+    float spiky = 30.0f / (PI * h5);
+    float laplacian = 40.0f / (PI * h5);
+    float restDensity = 1.0f / (settings.restSpacing * settings.restSpacing);
+    // A parcel's own contribution, W(0); no parcel's density is below it.
+    float selfDensity = poly6 * h2 * h2 * h2;
+
+    // Both passes copy the neighbors of a parcel into lane-padded scratch
+    // first. A bucket holds only a few parcels, too few to fill a vector;
+    // all of them together do. Padding sits far outside h and adds nothing.
+    start = std::chrono::steady_clock::now();
+    runParallel(jobs, count, [&](int begin, int end, int) {
+        int neighbors[MAX_CANDIDATES];
+        alignas(PARTICLE_ALIGNMENT) float nx[MAX_CANDIDATES + LANES], ny[MAX_CANDIDATES + LANES];
+        for (int i = begin; i < end; ++i) {
+            float xi = x[i], yi = y[i];
+            bool gotSelf;
+            int n = gatherNeighbors(grid, glm::vec2(xi, yi), i, neighbors, gotSelf);
+            for (int k = 0; k < n; ++k) {
+                nx[k] = x[neighbors[k]];
+                ny[k] = y[neighbors[k]];
+            }
+            int padded = (n + LANES - 1) / LANES * LANES;
+            for (int k = n; k < padded; ++k) {
+                nx[k] = FAR_AWAY;
+                ny[k] = FAR_AWAY;
+            }
+
+            float sum[LANES] = {};
+            for (int j = 0; j < padded; j += LANES) {
+                for (int k = 0; k < LANES; ++k) {
+                    float dx = nx[j + k] - xi;
+                    float dy = ny[j + k] - yi;
+                    float q = std::max(h2 - dx * dx - dy * dy, 0.0f);
+                    sum[k] += q * q * q;
+                }
+            }
+            float total = 0.0f;
+            for (int k = 0; k < LANES; ++k) total += sum[k];
+            density[i] = poly6 * total + (gotSelf ? 0.0f : selfDensity);
+            pressure[i] = std::max(settings.stiffness * (density[i] - restDensity), 0.0f);
+        }
+    });
+    timings.density += millisecondsSince(start);
+
+    const float* PARTICLE_RESTRICT rho = density.data();
+    const float* PARTICLE_RESTRICT p = pressure.data();
+    start = std::chrono::steady_clock::now();
+    runParallel(jobs, count, [&](int begin, int end, int) {
+        int neighbors[MAX_CANDIDATES];
+        alignas(PARTICLE_ALIGNMENT) float nx[MAX_CANDIDATES + LANES], ny[MAX_CANDIDATES + LANES];
+        alignas(PARTICLE_ALIGNMENT) float nvx[MAX_CANDIDATES + LANES], nvy[MAX_CANDIDATES + LANES];
+        alignas(PARTICLE_ALIGNMENT) float np[MAX_CANDIDATES + LANES], inverseRho[MAX_CANDIDATES + LANES];
+        for (int i = begin; i < end; ++i) {
+            float xi = x[i], yi = y[i], vxi = vx[i], vyi = vy[i], pi = p[i];
+            bool gotSelf;
+            int n = gatherNeighbors(grid, glm::vec2(xi, yi), i, neighbors, gotSelf);
+            for (int k = 0; k < n; ++k) {
+                int j = neighbors[k];
+                nx[k] = x[j];
+                ny[k] = y[j];
+                nvx[k] = vx[j];
+                nvy[k] = vy[j];
+                np[k] = p[j];
+                inverseRho[k] = 1.0f / std::max(rho[j], selfDensity);
+            }
+            int padded = (n + LANES - 1) / LANES * LANES;
+            for (int k = n; k < padded; ++k) {
+                nx[k] = FAR_AWAY;
+                ny[k] = FAR_AWAY;
+                nvx[k] = 0.0f;
+                nvy[k] = 0.0f;
+                np[k] = 0.0f;
+                inverseRho[k] = 0.0f;
+            }
+
+            // Pressure pushes i away from j by (p_i + p_j) / (2 rho_j) times
+            // the spiky gradient; viscosity pulls v_i towards v_j weighted by
+            // the Laplacian. Both vanish outside h and for i itself.
+            // Written without selects so the block vectorizes.
+            float pressureX[LANES] = {}, pressureY[LANES] = {};
+            float viscousX[LANES] = {}, viscousY[LANES] = {};
+            for (int j = 0; j < padded; j += LANES) {
+                for (int k = 0; k < LANES; ++k) {
+                    float dx = xi - nx[j + k];
+                    float dy = yi - ny[j + k];
+                    float r = std::sqrt(dx * dx + dy * dy);
+                    float gap = std::max(h - r, 0.0f);
+                    // A coincident pair has dx = dy = 0, so any finite
+                    // inverseR leaves it out.
+                    float inverseR = 1.0f / std::max(r, 1.0e-6f);
+                    float push = (pi + np[j + k]) * inverseRho[j + k] * gap * gap * inverseR;
+                    pressureX[k] += push * dx;
+                    pressureY[k] += push * dy;
+                    float drag = gap * inverseRho[j + k];
+                    viscousX[k] += drag * (nvx[j + k] - vxi);
+                    viscousY[k] += drag * (nvy[j + k] - vyi);
+                }
+            }
+
+            glm::vec2 pressureSum(0.0f), viscousSum(0.0f);
+            for (int k = 0; k < LANES; ++k) {
+                pressureSum += glm::vec2(pressureX[k], pressureY[k]);
+                viscousSum += glm::vec2(viscousX[k], viscousY[k]);
+            }
+            glm::vec2 acceleration = (0.5f * spiky * pressureSum + settings.viscosity * laplacian * viscousSum) / std::max(rho[i], selfDensity) + settings.gravity;
+
+            int slot = s.slot[i];
+            ParticleColumns columns = pool.getPage(slot >> PARTICLE_PAGE_SHIFT);
+            int entry = slot & (PARTICLE_PAGE_SIZE - 1);
+            columns.vx[entry] = vxi + acceleration.x * deltaTime;
+            columns.vy[entry] = vyi + acceleration.y * deltaTime;
+        }
+    });
+    timings.forces += millisecondsSince(start);
+}
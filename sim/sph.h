@@ -0,0 +1,59 @@
+#ifndef SPH_H
+#define SPH_H
+
+#include <glm/glm.hpp>
+#include <vector>
+#include "config.h"
+#include "job_system.h"
+#include "particle_pool.h"
+#include "spatial_hash.h"
+
+// Smoothed-particle hydrodynamics. Every live particle is a fluid parcel of
+// unit mass; lengths are in pixels and densities in parcels per px^2.
+struct FluidSettings {
+    bool enabled = false;
+    // Kernel support h; parcels further apart do not interact.
+    float smoothingRadius = 16.0f;
+    // Parcel spacing at rest, so the rest density is 1 / restSpacing^2.
+    float restSpacing = 8.0f;
+    // Pressure per unit of density above rest; its square root is the
+    // speed of sound. Below rest the pressure is clamped to zero.
+    float stiffness = 1.0e6f;
+    float viscosity = 10.0f;
+    glm::vec2 gravity = glm::vec2(0.0f, 400.0f);
+    // Parcels are kept inside this box.
+    glm::vec2 boundsMin = glm::vec2(0.0f);
+    glm::vec2 boundsMax = glm::vec2(SCR_WIDTH, SCR_HEIGHT);
+    // Explicit SPH is only stable for steps well under h / speed of sound,
+    // so every update is split into this many.
+    int substeps = 4;
+};
+
+// Milliseconds spent in each phase of the last update, summed over its
+// substeps. integrate covers the per-page pass: external forces,
+// integration, bounds and obstacles.
+struct FluidTimings {
+    double neighbors = 0.0;
+    double density = 0.0;
+    double forces = 0.0;
+    double integrate = 0.0;
+};
+
+// Müller-style SPH: poly6 density, spiky pressure gradient and the
+// viscosity Laplacian. Neighbors come from a SpatialHash with one cell per
+// smoothing radius. Each parcel accumulates over contiguous bucket ranges
+// in lane-wide blocks and writes only its own density or velocity, so both
+// passes run in parallel and give the same result on any thread count.
+class FluidSolver {
+public:
+    // Adds the pressure, viscosity and gravity accelerations times
+    // deltaTime to the velocities of the live particles, and the time spent
+    // to timings.
+    void step(ParticlePool& pool, const FluidSettings& settings, float deltaTime, JobSystem* jobs, FluidTimings& timings);
+
+private:
+    SpatialHash grid;
+    std::vector<float> density, pressure;
+};
+
+#endif // !SPH_H
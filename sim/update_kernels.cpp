@@ -0,0 +1,75 @@
+#include "update_kernels.h"
+#include <cmath>
+#include <utility>
+
+// GCC only takes restrict at its word for parameters; on locals it falls
+// back to run-time alias checks, too many of them here to vectorize.
+template <unsigned MODE>
+static void moveParticles(float* PARTICLE_RESTRICT x, float* PARTICLE_RESTRICT y,
+    float* PARTICLE_RESTRICT prevX, float* PARTICLE_RESTRICT prevY,
+    float* PARTICLE_RESTRICT vx, float* PARTICLE_RESTRICT vy,
+    float* PARTICLE_RESTRICT lifetime, int count, UpdateParams params) {
+    float deltaTime = params.deltaTime;
+    glm::vec2 point = params.forcePoint;
+    float strength = MODE & UPDATE_ATTRACT ? params.forceStrength : -params.forceStrength;
+    glm::vec2 minBound = params.boundsMin, maxBound = params.boundsMax;
+    float bounce = params.bounce;
+    ObstacleFieldView field = params.field;
+
+    for (int i = 0; i < count; ++i) {
+        bool alive = lifetime[i] > 0.0f;
+        float velocityX = vx[i], velocityY = vy[i];
+        if (MODE & UPDATE_FORCE) {
+            float dx = point.x - x[i];
+            float dy = point.y - y[i];
+            float length = std::sqrt(dx * dx + dy * dy);
+            bool active = (length > 0.0f) & alive;
+            float divisor = active ? length : 1.0f;
+            velocityX += active ? dx / divisor * strength * deltaTime : 0.0f;
+            velocityY += active ? dy / divisor * strength * deltaTime : 0.0f;
+        }
+
+        float step = alive ? deltaTime : 0.0f;
+        float oldX = x[i], oldY = y[i];
+        prevX[i] = oldX;
+        prevY[i] = oldY;
+        float newX = oldX + velocityX * step;
+        float newY = oldY + velocityY * step;
+        float remaining = lifetime[i] - step;
+        lifetime[i] = remaining > 0.0f ? remaining : 0.0f;
+
+        if (MODE & UPDATE_BOUNDS) {
+            float cx = newX < minBound.x ? minBound.x : (newX > maxBound.x ? maxBound.x : newX);
+            float cy = newY < minBound.y ? minBound.y : (newY > maxBound.y ? maxBound.y : newY);
+            velocityX = cx != newX ? -velocityX * bounce : velocityX;
+            velocityY = cy != newY ? -velocityY * bounce : velocityY;
+            newX = cx;
+            newY = cy;
+        }
+        if (MODE & UPDATE_FIELD) {
+            resolveFieldContact(field, alive, newX, newY, velocityX, velocityY);
+        }
+        x[i] = newX;
+        y[i] = newY;
+        vx[i] = velocityX;
+        vy[i] = velocityY;
+    }
+}
+
+template <unsigned MODE>
+void updatePage(const ParticleColumns& p, const UpdateParams& params) {
+    moveParticles<MODE>(p.x, p.y, p.prevX, p.prevY, p.vx, p.vy, p.lifetime, p.count, params);
+    if (MODE & OBSTACLE_MASK_ALL) {
+        collideObstacleTypes<MODE & OBSTACLE_MASK_ALL>(p, *params.colliders, params.tree);
+    }
+}
+
+template <unsigned... MODES>
+static const UpdateKernel* makeKernelTable(std::integer_sequence<unsigned, MODES...>) {
+    static const UpdateKernel table[] = { updatePage<MODES>... };
+    return table;
+}
+
+UpdateKernel getUpdateKernel(unsigned mode) {
+    return makeKernelTable(std::make_integer_sequence<unsigned, UPDATE_MODE_COUNT>())[mode];
+}
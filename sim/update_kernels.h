@@ -0,0 +1,56 @@
+#ifndef UPDATE_KERNELS_H
+#define UPDATE_KERNELS_H
+
+#include <glm/glm.hpp>
+#include "collision_kernels.h"
+#include "obstacle_field.h"
+#include "particle_pool.h"
+
+// The per-page pass of ParticleSystem::update fused into one kernel per mode
+// combination. The mode is fixed for a whole update, so it is a template
+// parameter: every instantiation is a straight loop over the columns
+// with no per-particle tests of global flags.
+//
+// The low bits are the ObstacleTypeMask of the obstacles to sweep against,
+// zero when they are left to a later pass or to the distance field.
+enum UpdateMode {
+    // Applies the point force.
+    UPDATE_FORCE = 1 << 4,
+    // The point force pulls; without it, it pushes.
+    UPDATE_ATTRACT = 1 << 5,
+    // Confines particles to UpdateParams' box.
+    UPDATE_BOUNDS = 1 << 6,
+    // Collides with UpdateParams' obstacle field at the end of the move.
+    UPDATE_FIELD = 1 << 7,
+    UPDATE_MODE_COUNT = 1 << 8
+};
+
+struct UpdateParams {
+    float deltaTime;
+    glm::vec2 forcePoint;
+    // Magnitude of the point force; UPDATE_ATTRACT gives its sign.
+    float forceStrength;
+    glm::vec2 boundsMin, boundsMax;
+    float bounce;
+    const ObstacleColliders* colliders;
+    const ObstacleTree* tree;
+    ObstacleFieldView field;
+};
+
+typedef void (*UpdateKernel)(const ParticleColumns& p, const UpdateParams& params);
+
+// Force, integration, confinement and field collision in one loop over p,
+// then swept obstacle collision. The loop is the only implementation of the
+// move: it ages live particles, keeps the old position in prevX/prevY, and
+// clamps into the bounds, reversing the velocity component that carried a
+// particle out, scaled by bounce. The force and field steps match
+// applyPointForce and collideObstacleField, and the collision step is
+// collideObstacleTypes.
+template <unsigned MODE>
+void updatePage(const ParticleColumns& p, const UpdateParams& params);
+
+// The instantiation of updatePage for mode, which must be below
+// UPDATE_MODE_COUNT.
+UpdateKernel getUpdateKernel(unsigned mode);
+
+#endif // !UPDATE_KERNELS_H